@@ -2,6 +2,8 @@
 #include "board.h"
 #include "display.h"
 #include "system_info.h"
+#include "task_profiler.h"
+#include "trace_recorder.h"
 #include "audio_codec.h"
 #include "mqtt_protocol.h"
 #include "websocket_protocol.h"
@@ -11,14 +13,19 @@
 #include "settings.h"
 
 #include <cstring>
+#include <algorithm>
 #include <esp_log.h>
 #include <cJSON.h>
 #include <driver/gpio.h>
 #include <arpa/inet.h>
+#include <sys/time.h>
 #include <font_awesome.h>
 
 #define TAG "Application"
 
+// Battery and network are polled, the clock is updated on minute boundaries
+#define STATUS_BAR_POLL_INTERVAL_S 10
+
 
 static const char* const STATE_STRINGS[] = {
     "unknown",
@@ -59,6 +66,18 @@ Application::Application() {
         .skip_unhandled_events = true
     };
     esp_timer_create(&clock_timer_args, &clock_timer_handle_);
+
+    esp_timer_create_args_t delayed_timer_args = {
+        .callback = [](void* arg) {
+            Application* app = (Application*)arg;
+            xEventGroupSetBits(app->event_group_, MAIN_EVENT_SCHEDULE);
+        },
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "delayed_tasks",
+        .skip_unhandled_events = true
+    };
+    esp_timer_create(&delayed_timer_args, &delayed_timer_handle_);
 }
 
 Application::~Application() {
@@ -66,6 +85,10 @@ Application::~Application() {
         esp_timer_stop(clock_timer_handle_);
         esp_timer_delete(clock_timer_handle_);
     }
+    if (delayed_timer_handle_ != nullptr) {
+        esp_timer_stop(delayed_timer_handle_);
+        esp_timer_delete(delayed_timer_handle_);
+    }
     vEventGroupDelete(event_group_);
 }
 
@@ -278,7 +301,7 @@ void Application::ToggleChatState() {
     } else if (device_state_ == kDeviceStateSpeaking) {
         Schedule([this]() {
             AbortSpeaking(kAbortReasonNone);
-        });
+        }, kSchedulePriorityUrgent);
     } else if (device_state_ == kDeviceStateListening) {
         Schedule([this]() {
             protocol_->CloseAudioChannel();
@@ -315,6 +338,9 @@ void Application::StartListening() {
     } else if (device_state_ == kDeviceStateSpeaking) {
         Schedule([this]() {
             AbortSpeaking(kAbortReasonNone);
+        }, kSchedulePriorityUrgent);
+        // The state change stays behind the protocol events already queued, like a pending tts start
+        Schedule([this]() {
             SetListeningMode(kListeningModeManualStop);
         });
     }
@@ -346,6 +372,7 @@ void Application::StopListening() {
 }
 
 void Application::Start() {
+    TraceRecorder::Start();
     auto& board = Board::GetInstance();
     SetDeviceState(kDeviceStateStarting);
 
@@ -379,13 +406,18 @@ void Application::Start() {
     }, "main_event_loop", 2048 * 4, this, 3, &main_event_loop_task_handle_);
 
     /* Start the clock timer to update the status bar */
-    esp_timer_start_periodic(clock_timer_handle_, 1000000);
+    esp_timer_start_periodic(clock_timer_handle_, STATUS_BAR_POLL_INTERVAL_S * 1000000);
+
+#if CONFIG_USE_TASK_PROFILER
+    TaskProfiler::GetInstance().Start(CONFIG_TASK_PROFILER_PERIOD_MS);
+#endif
 
     /* Wait for the network to be ready */
     board.StartNetwork();
 
     // Update the status bar immediately to show the network state
     display->UpdateStatusBar(true);
+    ScheduleClockUpdate();
 
     // Check for new assets version
     CheckAssetsVersion();
@@ -439,19 +471,18 @@ void Application::Start() {
             SetDeviceState(kDeviceStateIdle);
         });
     });
-    protocol_->OnIncomingJson([this, display](const cJSON* root) {
-        // Parse JSON data
-        auto type = cJSON_GetObjectItem(root, "type");
-        if (strcmp(type->valuestring, "tts") == 0) {
-            auto state = cJSON_GetObjectItem(root, "state");
-            if (strcmp(state->valuestring, "start") == 0) {
+    protocol_->OnIncomingMessageFields([this, display](const JsonMessageFields& fields) {
+        // Views are NUL terminated, but only valid during this call
+        if (fields.type == "tts") {
+            if (fields.state == "start") {
                 Schedule([this]() {
                     aborted_ = false;
+                    append_chat_sentence_ = false;
                     if (device_state_ == kDeviceStateIdle || device_state_ == kDeviceStateListening) {
                         SetDeviceState(kDeviceStateSpeaking);
                     }
                 });
-            } else if (strcmp(state->valuestring, "stop") == 0) {
+            } else if (fields.state == "stop") {
                 Schedule([this]() {
                     if (device_state_ == kDeviceStateSpeaking) {
                         if (listening_mode_ == kListeningModeManualStop) {
@@ -461,33 +492,41 @@ void Application::Start() {
                         }
                     }
                 });
-            } else if (strcmp(state->valuestring, "sentence_start") == 0) {
-                auto text = cJSON_GetObjectItem(root, "text");
-                if (cJSON_IsString(text)) {
-                    ESP_LOGI(TAG, "<< %s", text->valuestring);
-                    Schedule([this, display, message = std::string(text->valuestring)]() {
-                        display->SetChatMessage("assistant", message.c_str());
+            } else if (fields.state == "sentence_start") {
+                if (!fields.text.empty()) {
+                    ESP_LOGI(TAG, "<< %s", fields.text.data());
+                    Schedule([this, display, message = std::string(fields.text)]() {
+                        // The sentences of one answer are streamed into the same chat message
+                        if (append_chat_sentence_) {
+                            display->AppendChatText("assistant", message.c_str());
+                        } else {
+                            display->SetChatMessage("assistant", message.c_str());
+                            append_chat_sentence_ = true;
+                        }
                     });
                 }
             }
-        } else if (strcmp(type->valuestring, "stt") == 0) {
-            auto text = cJSON_GetObjectItem(root, "text");
-            if (cJSON_IsString(text)) {
-                ESP_LOGI(TAG, ">> %s", text->valuestring);
-                Schedule([this, display, message = std::string(text->valuestring)]() {
+        } else if (fields.type == "stt") {
+            if (!fields.text.empty()) {
+                ESP_LOGI(TAG, ">> %s", fields.text.data());
+                Schedule([this, display, message = std::string(fields.text)]() {
                     display->SetChatMessage("user", message.c_str());
                 });
             }
-        } else if (strcmp(type->valuestring, "llm") == 0) {
-            auto emotion = cJSON_GetObjectItem(root, "emotion");
-            if (cJSON_IsString(emotion)) {
-                Schedule([this, display, emotion_str = std::string(emotion->valuestring)]() {
+        } else if (fields.type == "llm") {
+            if (!fields.emotion.empty()) {
+                Schedule([this, display, emotion_str = std::string(fields.emotion)]() {
                     display->SetEmotion(emotion_str.c_str());
                 });
             }
-        } else if (strcmp(type->valuestring, "mcp") == 0) {
+        }
+    });
+    protocol_->OnIncomingJson([this, display](const cJSON* root) {
+        // Parse JSON data
+        auto type = cJSON_GetObjectItem(root, "type");
+        if (strcmp(type->valuestring, "mcp") == 0) {
             auto payload = cJSON_GetObjectItem(root, "payload");
-            if (cJSON_IsObject(payload)) {
+            if (cJSON_IsObject(payload) || cJSON_IsArray(payload)) {
                 McpServer::GetInstance().ParseMessage(payload);
             }
         } else if (strcmp(type->valuestring, "system") == 0) {
@@ -519,7 +558,7 @@ void Application::Start() {
             if (cJSON_IsObject(payload)) {
                 Schedule([this, display, payload_str = std::string(cJSON_PrintUnformatted(payload))]() {
                     display->SetChatMessage("system", payload_str.c_str());
-                });
+                }, kSchedulePriorityBackground);
             } else {
                 ESP_LOGW(TAG, "Invalid custom message format: missing payload");
             }
@@ -544,14 +583,142 @@ void Application::Start() {
 }
 
 // Add a async task to MainLoop
-void Application::Schedule(std::function<void()> callback) {
+void Application::Schedule(std::function<void()> callback, SchedulePriority priority) {
     {
         std::lock_guard<std::mutex> lock(mutex_);
-        main_tasks_.push_back(std::move(callback));
+        auto& lane = main_tasks_[priority];
+        lane.push_back(std::move(callback));
+        if (lane.size() > schedule_statistics_.max_depth[priority]) {
+            schedule_statistics_.max_depth[priority] = lane.size();
+        }
     }
     xEventGroupSetBits(event_group_, MAIN_EVENT_SCHEDULE);
 }
 
+bool Application::DelayedTaskLater(const DelayedTask& a, const DelayedTask& b) {
+    return a.deadline_us > b.deadline_us || (a.deadline_us == b.deadline_us && a.sequence > b.sequence);
+}
+
+void Application::ScheduleAfter(uint32_t delay_ms, std::function<void()> callback, SchedulePriority priority) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    int64_t deadline_us = esp_timer_get_time() + (int64_t)delay_ms * 1000;
+    delayed_tasks_.push_back({deadline_us, delayed_task_sequence_++, priority, std::move(callback)});
+    std::push_heap(delayed_tasks_.begin(), delayed_tasks_.end(), DelayedTaskLater);
+    // Only a new earliest deadline needs the timer to be moved
+    if (delayed_tasks_.front().deadline_us == deadline_us) {
+        ArmDelayedTimer();
+    }
+}
+
+// Must be called with mutex_ held
+void Application::ArmDelayedTimer() {
+    esp_timer_stop(delayed_timer_handle_);
+    if (delayed_tasks_.empty()) {
+        return;
+    }
+    int64_t delay_us = delayed_tasks_.front().deadline_us - esp_timer_get_time();
+    if (delay_us <= 0) {
+        xEventGroupSetBits(event_group_, MAIN_EVENT_SCHEDULE);
+    } else {
+        esp_timer_start_once(delayed_timer_handle_, delay_us);
+    }
+}
+
+// Must be called with mutex_ held
+void Application::PromoteDelayedTasks() {
+    if (delayed_tasks_.empty()) {
+        return;
+    }
+    int64_t now = esp_timer_get_time();
+    bool promoted = false;
+    while (!delayed_tasks_.empty() && delayed_tasks_.front().deadline_us <= now) {
+        std::pop_heap(delayed_tasks_.begin(), delayed_tasks_.end(), DelayedTaskLater);
+        auto& task = delayed_tasks_.back();
+        main_tasks_[task.priority].push_back(std::move(task.callback));
+        delayed_tasks_.pop_back();
+        promoted = true;
+    }
+    if (promoted) {
+        ArmDelayedTimer();
+    }
+}
+
+void Application::RunScheduledTasks() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    PromoteDelayedTasks();
+    // Run as many tasks as are queued now, tasks queued meanwhile set the event bit again.
+    // The highest lane is picked for every task, so urgent work overtakes queued UI updates.
+    size_t pending = 0;
+    for (auto& lane : main_tasks_) {
+        pending += lane.size();
+    }
+    while (pending-- > 0) {
+        int priority = 0;
+        while (priority < kSchedulePriorityCount && main_tasks_[priority].empty()) {
+            priority++;
+        }
+        if (priority == kSchedulePriorityCount) {
+            break;
+        }
+        auto task = std::move(main_tasks_[priority].front());
+        main_tasks_[priority].pop_front();
+        lock.unlock();
+
+        int64_t start_time = esp_timer_get_time();
+        {
+            TRACE_SCOPE(kTraceEventMainTask, priority);
+            task();
+        }
+        int64_t run_time_us = esp_timer_get_time() - start_time;
+        if (run_time_us > CONFIG_SCHEDULE_TASK_BUDGET_MS * 1000) {
+            ESP_LOGW(TAG, "Scheduled task in lane %d took %lld ms, budget %d ms", priority, run_time_us / 1000,
+                CONFIG_SCHEDULE_TASK_BUDGET_MS);
+        }
+
+        lock.lock();
+        if (run_time_us > schedule_statistics_.max_run_time_us) {
+            schedule_statistics_.max_run_time_us = run_time_us;
+        }
+        if (run_time_us > CONFIG_SCHEDULE_TASK_BUDGET_MS * 1000) {
+            schedule_statistics_.over_budget++;
+        }
+    }
+}
+
+void Application::PrintScheduleStatistics() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& stats = schedule_statistics_;
+    int64_t now = esp_timer_get_time();
+    uint32_t wakeups_per_minute = stats.wakeups * 60000000LL / std::max<int64_t>(now - stats.start_time_us, 1);
+    ESP_LOGI(TAG, "Schedule: max depth %u/%u/%u, delayed %u, max run %lld us, over budget %lu, wakeups %lu/min",
+        stats.max_depth[kSchedulePriorityUrgent], stats.max_depth[kSchedulePriorityNormal],
+        stats.max_depth[kSchedulePriorityBackground], delayed_tasks_.size(), stats.max_run_time_us, stats.over_budget,
+        wakeups_per_minute);
+    stats = {};
+    stats.start_time_us = now;
+}
+
+void Application::PrintUplinkStatistics() {
+#if CONFIG_USE_ADAPTIVE_UPLINK
+    // The settings the uplink controller ended up with, to compare cellular and Wi-Fi links
+    auto stats = audio_service_.GetUplinkStatistics();
+    ESP_LOGI(TAG, "Uplink (%s): complexity %d, dtx %s, congested %s, cpu idle %d%%, max queue %lu, send failures %lu, adjustments %lu",
+        stats.cellular ? "cellular" : "wifi", stats.complexity, stats.dtx ? "on" : "off", stats.congested ? "yes" : "no",
+        stats.cpu_idle_percent, stats.max_queue_depth, stats.send_failures, stats.adjustments);
+#endif
+}
+
+void Application::ScheduleClockUpdate() {
+    // Fire just after the next minute boundary, so the clock changes with the wall time
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    uint32_t delay_ms = (60 - tv.tv_sec % 60) * 1000 - tv.tv_usec / 1000 + 50;
+    ScheduleAfter(delay_ms, [this]() {
+        Board::GetInstance().GetDisplay()->UpdateClock();
+        ScheduleClockUpdate();
+    }, kSchedulePriorityBackground);
+}
+
 // The Main Event Loop controls the chat state and websocket connection
 // If other tasks need to access the websocket or chat state,
 // they should use Schedule to call this function
@@ -563,6 +730,10 @@ void Application::MainEventLoop() {
             MAIN_EVENT_VAD_CHANGE |
             MAIN_EVENT_CLOCK_TICK |
             MAIN_EVENT_ERROR, pdTRUE, pdFALSE, portMAX_DELAY);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            schedule_statistics_.wakeups++;
+        }
 
         if (bits & MAIN_EVENT_ERROR) {
             SetDeviceState(kDeviceStateIdle);
@@ -572,6 +743,7 @@ void Application::MainEventLoop() {
         if (bits & MAIN_EVENT_SEND_AUDIO) {
             while (auto packet = audio_service_.PopPacketFromSendQueue()) {
                 if (protocol_ && !protocol_->SendAudio(std::move(packet))) {
+                    audio_service_.ReportSendFailure();
                     break;
                 }
             }
@@ -589,25 +761,19 @@ void Application::MainEventLoop() {
         }
 
         if (bits & MAIN_EVENT_SCHEDULE) {
-            std::unique_lock<std::mutex> lock(mutex_);
-            auto tasks = std::move(main_tasks_);
-            lock.unlock();
-            for (auto& task : tasks) {
-                task();
-            }
+            RunScheduledTasks();
         }
 
         if (bits & MAIN_EVENT_CLOCK_TICK) {
-            clock_ticks_++;
             auto display = Board::GetInstance().GetDisplay();
             display->UpdateStatusBar();
-        
-            // Print the debug info every 10 seconds
-            if (clock_ticks_ % 10 == 0) {
-                // SystemInfo::PrintTaskCpuUsage(pdMS_TO_TICKS(1000));
-                // SystemInfo::PrintTaskList();
-                SystemInfo::PrintHeapStats();
-            }
+
+            // Print the debug info on every poll
+            // Enable CONFIG_USE_TASK_PROFILER for per task CPU usage, it samples in the background
+            SystemInfo::PrintHeapStats();
+            PrintScheduleStatistics();
+            PrintUplinkStatistics();
+            display->PrintRenderStatistics();
         }
     }
 }
@@ -660,6 +826,18 @@ void Application::AbortSpeaking(AbortReason reason) {
 
 void Application::SetListeningMode(ListeningMode mode) {
     listening_mode_ = mode;
+
+    // In realtime conversations late audio is worse than missing audio
+    auto send_queue_policy = kSendQueuePolicyBlock;
+    if (mode == kListeningModeRealtime) {
+#if CONFIG_REALTIME_SEND_QUEUE_DROP_OLDEST
+        send_queue_policy = kSendQueuePolicyDropOldest;
+#elif CONFIG_REALTIME_SEND_QUEUE_DROP_NEWEST
+        send_queue_policy = kSendQueuePolicyDropNewest;
+#endif
+    }
+    audio_service_.SetSendQueuePolicy(send_queue_policy);
+    audio_service_.EnableSilenceSuppression(mode == kListeningModeRealtime);
     SetDeviceState(kDeviceStateListening);
 }
 
@@ -668,9 +846,10 @@ void Application::SetDeviceState(DeviceState state) {
         return;
     }
     
-    clock_ticks_ = 0;
     auto previous_state = device_state_;
     device_state_ = state;
+    TRACE_END(kTraceEventDeviceState, previous_state);
+    TRACE_BEGIN(kTraceEventDeviceState, state);
     ESP_LOGI(TAG, "STATE: %s", STATE_STRINGS[device_state_]);
 
     // Send the state change event
@@ -685,6 +864,10 @@ void Application::SetDeviceState(DeviceState state) {
         case kDeviceStateIdle:
             display->SetStatus(Lang::Strings::STANDBY);
             display->SetEmotion("neutral");
+            // Show the clock once the standby status has been on screen for a while
+            ScheduleAfter(10500, [display]() {
+                display->UpdateClock();
+            }, kSchedulePriorityBackground);
             audio_service_.EnableVoiceProcessing(false);
             audio_service_.EnableWakeWordDetection(true);
             break;
@@ -820,7 +1003,7 @@ void Application::WakeWordInvoke(const std::string& wake_word) {
     } else if (device_state_ == kDeviceStateSpeaking) {
         Schedule([this]() {
             AbortSpeaking(kAbortReasonNone);
-        });
+        }, kSchedulePriorityUrgent);
     } else if (device_state_ == kDeviceStateListening) {   
         Schedule([this]() {
             if (protocol_) {
@@ -847,17 +1030,17 @@ bool Application::CanEnterSleepMode() {
     return true;
 }
 
-void Application::SendMcpMessage(const std::string& payload) {
+void Application::SendMcpMessage(std::string payload) {
     if (protocol_ == nullptr) {
         return;
     }
 
     // Make sure you are using main thread to send MCP message
     if (xTaskGetCurrentTaskHandle() == main_event_loop_task_handle_) {
-        protocol_->SendMcpMessage(payload);
+        protocol_->SendMcpMessage(std::move(payload));
     } else {
-        Schedule([this, payload = std::move(payload)]() {
-            protocol_->SendMcpMessage(payload);
+        Schedule([this, payload = std::move(payload)]() mutable {
+            protocol_->SendMcpMessage(std::move(payload));
         });
     }
 }
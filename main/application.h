@@ -9,6 +9,7 @@
 #include <string>
 #include <mutex>
 #include <deque>
+#include <vector>
 #include <memory>
 
 #include "protocol.h"
@@ -26,6 +27,15 @@
 #define MAIN_EVENT_CLOCK_TICK (1 << 6)
 
 
+// Lanes of the main event loop, queued tasks of an earlier lane always run first
+enum SchedulePriority {
+    // Aborts only: protocol events and state changes that must stay in order use the normal lane
+    kSchedulePriorityUrgent,
+    kSchedulePriorityNormal,
+    kSchedulePriorityBackground,    // Work that may wait until the loop is otherwise idle
+    kSchedulePriorityCount
+};
+
 enum AecMode {
     kAecOff,
     kAecOnDeviceSide,
@@ -46,7 +56,9 @@ public:
     void MainEventLoop();
     DeviceState GetDeviceState() const { return device_state_; }
     bool IsVoiceDetected() const { return audio_service_.IsVoiceDetected(); }
-    void Schedule(std::function<void()> callback);
+    void Schedule(std::function<void()> callback, SchedulePriority priority = kSchedulePriorityNormal);
+    // Run the callback in the main event loop after at least delay_ms
+    void ScheduleAfter(uint32_t delay_ms, std::function<void()> callback, SchedulePriority priority = kSchedulePriorityNormal);
     void SetDeviceState(DeviceState state);
     void Alert(const char* status, const char* message, const char* emotion = "", const std::string_view& sound = "");
     void DismissAlert();
@@ -58,7 +70,7 @@ public:
     void WakeWordInvoke(const std::string& wake_word);
     bool UpgradeFirmware(Ota& ota, const std::string& url = "");
     bool CanEnterSleepMode();
-    void SendMcpMessage(const std::string& payload);
+    void SendMcpMessage(std::string payload);
     void SetAecMode(AecMode mode);
     AecMode GetAecMode() const { return aec_mode_; }
     void PlaySound(const std::string_view& sound);
@@ -68,8 +80,27 @@ private:
     Application();
     ~Application();
 
+    struct DelayedTask {
+        int64_t deadline_us;
+        uint32_t sequence;
+        SchedulePriority priority;
+        std::function<void()> callback;
+    };
+    struct ScheduleStatistics {
+        size_t max_depth[kSchedulePriorityCount];
+        int64_t max_run_time_us;
+        uint32_t over_budget;
+        uint32_t wakeups;
+        int64_t start_time_us;
+    };
+
     std::mutex mutex_;
-    std::deque<std::function<void()>> main_tasks_;
+    std::deque<std::function<void()>> main_tasks_[kSchedulePriorityCount];
+    // Min-heap on the deadline, served by a single one-shot timer armed for the earliest entry
+    std::vector<DelayedTask> delayed_tasks_;
+    uint32_t delayed_task_sequence_ = 0;
+    esp_timer_handle_t delayed_timer_handle_ = nullptr;
+    ScheduleStatistics schedule_statistics_ = {};
     std::unique_ptr<Protocol> protocol_;
     EventGroupHandle_t event_group_ = nullptr;
     esp_timer_handle_t clock_timer_handle_ = nullptr;
@@ -81,11 +112,18 @@ private:
 
     bool has_server_time_ = false;
     bool aborted_ = false;
-    int clock_ticks_ = 0;
+    bool append_chat_sentence_ = false;
     TaskHandle_t check_new_version_task_handle_ = nullptr;
     TaskHandle_t main_event_loop_task_handle_ = nullptr;
 
     void OnWakeWordDetected();
+    void RunScheduledTasks();
+    void PromoteDelayedTasks();
+    void ArmDelayedTimer();
+    void PrintScheduleStatistics();
+    void PrintUplinkStatistics();
+    void ScheduleClockUpdate();
+    static bool DelayedTaskLater(const DelayedTask& a, const DelayedTask& b);
     void CheckNewVersion(Ota& ota);
     void CheckAssetsVersion();
     void ShowActivationCode(const std::string& code, const std::string& message);
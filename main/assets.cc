@@ -4,6 +4,7 @@
 #include "application.h"
 #include "lvgl_theme.h"
 #include "emote_display.h"
+#include "json_arena.h"
 
 #include <esp_log.h>
 #include <spi_flash_mmap.h>
@@ -109,6 +110,7 @@ bool Assets::Apply() {
         return false;
     }
 
+    JsonArenaScope arena("assets");
     cJSON* root = cJSON_ParseWithLength(static_cast<char*>(ptr), size);
     if (root == nullptr) {
         ESP_LOGE(TAG, "The index.json file is not valid");
@@ -53,6 +53,12 @@ void AudioCodec::SetOutputVolume(int volume) {
     
     Settings settings("audio", true);
     settings.SetInt("output_volume", output_volume_);
+
+    // The status bar no longer polls the volume, publish the mute state on change
+    auto display = Board::GetInstance().GetDisplay();
+    if (display != nullptr) {
+        display->SetMuted(output_volume_ == 0);
+    }
 }
 
 void AudioCodec::SetInputGain(float gain) {
@@ -1,4 +1,5 @@
 #include "audio_service.h"
+#include "trace_recorder.h"
 #include <esp_log.h>
 #include <cstring>
 
@@ -36,7 +37,17 @@ void AudioService::Initialize(AudioCodec* codec) {
     /* Setup the audio codec */
     opus_decoder_ = std::make_unique<OpusDecoderWrapper>(codec->output_sample_rate(), 1, OPUS_FRAME_DURATION_MS);
     opus_encoder_ = std::make_unique<OpusEncoderWrapper>(16000, 1, OPUS_FRAME_DURATION_MS);
+#if CONFIG_USE_ADAPTIVE_UPLINK
+    bool cellular = Board::GetInstance().GetBoardType() == "ml307";
+    uplink_controller_.Initialize(opus_encoder_.get(), cellular, MAX_SEND_PACKETS_IN_QUEUE);
+#else
     opus_encoder_->SetComplexity(0);
+#endif
+
+#if CONFIG_USE_UPLINK_SILENCE_SUPPRESSION
+    silence_gate_.Configure(OPUS_FRAME_DURATION_MS, CONFIG_UPLINK_SILENCE_HANGOVER_MS,
+        CONFIG_UPLINK_SILENCE_PREROLL_MS, UPLINK_SILENCE_KEEPALIVE_MS);
+#endif
 
     if (codec->input_sample_rate() != 16000) {
         input_resampler_.Configure(codec->input_sample_rate(), 16000);
@@ -54,7 +65,11 @@ void AudioService::Initialize(AudioCodec* codec) {
     });
 
     audio_processor_->OnVadStateChange([this](bool speaking) {
-        voice_detected_ = speaking;
+        {
+            // Frames output after this point are tagged with the new state under the same lock
+            std::lock_guard<std::mutex> lock(audio_queue_mutex_);
+            voice_detected_ = speaking;
+        }
         if (callbacks_.on_vad_change) {
             callbacks_.on_vad_change(speaking);
         }
@@ -133,6 +148,7 @@ void AudioService::Stop() {
 }
 
 bool AudioService::ReadAudioData(std::vector<int16_t>& data, int sample_rate, int samples) {
+    TRACE_SCOPE(kTraceEventAudioInput);
     if (!codec_->input_enabled()) {
         esp_timer_stop(audio_power_timer_);
         esp_timer_start_periodic(audio_power_timer_, AUDIO_POWER_CHECK_INTERVAL_MS * 1000);
@@ -274,7 +290,9 @@ void AudioService::AudioOutputTask() {
             esp_timer_start_periodic(audio_power_timer_, AUDIO_POWER_CHECK_INTERVAL_MS * 1000);
             codec_->EnableOutput(true);
         }
+        TRACE_BEGIN(kTraceEventAudioOutput);
         codec_->OutputData(task->pcm);
+        TRACE_END(kTraceEventAudioOutput);
 
         /* Update the last output time */
         last_output_time_ = std::chrono::steady_clock::now();
@@ -297,7 +315,7 @@ void AudioService::OpusCodecTask() {
         std::unique_lock<std::mutex> lock(audio_queue_mutex_);
         audio_queue_cv_.wait(lock, [this]() {
             return service_stopped_ ||
-                (!audio_encode_queue_.empty() && audio_send_queue_.size() < MAX_SEND_PACKETS_IN_QUEUE) ||
+                (!audio_encode_queue_.empty() && CanEncodeToSendQueue()) ||
                 (!audio_decode_queue_.empty() && audio_playback_queue_.size() < MAX_PLAYBACK_TASKS_IN_QUEUE);
         });
         if (service_stopped_) {
@@ -316,7 +334,12 @@ void AudioService::OpusCodecTask() {
             task->timestamp = packet->timestamp;
 
             SetDecodeSampleRate(packet->sample_rate, packet->frame_duration);
-            if (opus_decoder_->Decode(std::move(packet->payload), task->pcm)) {
+            // The decoder takes the payload over
+            packet->payload_charge.Reset();
+            TRACE_BEGIN(kTraceEventOpusDecode);
+            bool decoded = opus_decoder_->Decode(std::move(packet->payload), task->pcm);
+            TRACE_END(kTraceEventOpusDecode);
+            if (decoded) {
                 // Resample if the sample rate is different
                 if (opus_decoder_->sample_rate() != codec_->output_sample_rate()) {
                     int target_size = output_resampler_.GetOutputSamples(task->pcm.size());
@@ -336,7 +359,7 @@ void AudioService::OpusCodecTask() {
         }
         
         /* Encode the audio to send queue */
-        if (!audio_encode_queue_.empty() && audio_send_queue_.size() < MAX_SEND_PACKETS_IN_QUEUE) {
+        if (!audio_encode_queue_.empty() && CanEncodeToSendQueue()) {
             auto task = std::move(audio_encode_queue_.front());
             audio_encode_queue_.pop_front();
             audio_queue_cv_.notify_all();
@@ -346,16 +369,18 @@ void AudioService::OpusCodecTask() {
             packet->frame_duration = OPUS_FRAME_DURATION_MS;
             packet->sample_rate = 16000;
             packet->timestamp = task->timestamp;
-            if (!opus_encoder_->Encode(std::move(task->pcm), packet->payload)) {
+            TRACE_BEGIN(kTraceEventOpusEncode);
+            bool encoded = opus_encoder_->Encode(std::move(task->pcm), packet->payload);
+            TRACE_END(kTraceEventOpusEncode);
+            if (!encoded) {
                 ESP_LOGE(TAG, "Failed to encode audio");
                 continue;
             }
 
+            packet->payload_charge = HeapCharge(kHeapTagAudio, packet->payload.data());
             if (task->type == kAudioTaskTypeEncodeToSendQueue) {
-                {
-                    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-                    audio_send_queue_.push_back(std::move(packet));
-                }
+                size_t send_queue_size = PushPacketToSendQueue(std::move(packet), task->voice_detected);
+                uplink_controller_.OnPacketQueued(send_queue_size);
                 if (callbacks_.on_send_queue_available) {
                     callbacks_.on_send_queue_available();
                 }
@@ -393,6 +418,7 @@ void AudioService::PushTaskToEncodeQueue(AudioTaskType type, std::vector<int16_t
     
     /* Push the task to the encode queue */
     std::unique_lock<std::mutex> lock(audio_queue_mutex_);
+    task->voice_detected = voice_detected_;
 
     /* If the task is to send queue, we need to set the timestamp */
     if (type == kAudioTaskTypeEncodeToSendQueue && !timestamp_queue_.empty()) {
@@ -404,11 +430,101 @@ void AudioService::PushTaskToEncodeQueue(AudioTaskType type, std::vector<int16_t
         timestamp_queue_.pop_front();
     }
 
-    audio_queue_cv_.wait(lock, [this]() { return audio_encode_queue_.size() < MAX_ENCODE_TASKS_IN_QUEUE; });
+    if (type == kAudioTaskTypeEncodeToSendQueue && send_queue_policy_ != kSendQueuePolicyBlock) {
+        /* Never stall the capture task (and the AFE feed), drop the oldest PCM frame instead */
+        if (audio_encode_queue_.size() >= MAX_ENCODE_TASKS_IN_QUEUE) {
+            audio_encode_queue_.pop_front();
+            debug_statistics_.encode_drop_count++;
+        }
+    } else {
+        audio_queue_cv_.wait(lock, [this]() { return audio_encode_queue_.size() < MAX_ENCODE_TASKS_IN_QUEUE; });
+    }
     audio_encode_queue_.push_back(std::move(task));
     audio_queue_cv_.notify_all();
 }
 
+bool AudioService::CanEncodeToSendQueue() const {
+    /* With a drop policy the encoder keeps running and the send queue handles the overflow */
+    return send_queue_policy_ != kSendQueuePolicyBlock || audio_send_queue_.size() < MAX_SEND_PACKETS_IN_QUEUE;
+}
+
+size_t AudioService::PushPacketToSendQueue(std::unique_ptr<AudioStreamPacket> packet, bool voice_detected) {
+    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
+    if (silence_suppression_enabled_) {
+        silence_gate_.Process(std::move(packet), voice_detected, [this](std::unique_ptr<AudioStreamPacket> packet) {
+            EnqueueSendPacket(std::move(packet));
+        });
+    } else {
+        EnqueueSendPacket(std::move(packet));
+    }
+    return audio_send_queue_.size();
+}
+
+// Must be called with audio_queue_mutex_ held
+void AudioService::EnqueueSendPacket(std::unique_ptr<AudioStreamPacket> packet) {
+    if (audio_send_queue_.size() >= MAX_SEND_PACKETS_IN_QUEUE && send_queue_policy_ != kSendQueuePolicyBlock) {
+        if (!send_queue_overflowed_) {
+            ESP_LOGW(TAG, "Send queue is full, dropping %s packets",
+                send_queue_policy_ == kSendQueuePolicyDropOldest ? "oldest" : "newest");
+            send_queue_overflowed_ = true;
+        }
+        send_queue_overflow_drops_++;
+        debug_statistics_.send_drop_count++;
+        if (send_queue_policy_ == kSendQueuePolicyDropOldest) {
+            audio_send_queue_.pop_front();
+        } else {
+            send_queue_gap_pending_ = !packet->payload.empty();
+            if (send_queue_gap_pending_) {
+                // Keep the TOC byte of the dropped packet, code 0 with an empty frame is a DTX frame
+                send_queue_gap_toc_ = packet->payload[0] & 0xFC;
+            }
+            return;
+        }
+    } else if (send_queue_overflowed_) {
+        ESP_LOGW(TAG, "Send queue recovered after dropping %lu packets", send_queue_overflow_drops_);
+        send_queue_overflowed_ = false;
+        send_queue_overflow_drops_ = 0;
+    }
+
+    /* Tell the server about the dropped audio so that it can conceal the gap */
+    if (send_queue_gap_pending_ && audio_send_queue_.size() + 1 < MAX_SEND_PACKETS_IN_QUEUE) {
+        auto marker = std::make_unique<AudioStreamPacket>();
+        marker->sample_rate = packet->sample_rate;
+        marker->frame_duration = packet->frame_duration;
+        marker->timestamp = packet->timestamp;
+        marker->payload.push_back(send_queue_gap_toc_);
+        audio_send_queue_.push_back(std::move(marker));
+        send_queue_gap_pending_ = false;
+        debug_statistics_.dtx_marker_count++;
+    }
+    audio_send_queue_.push_back(std::move(packet));
+}
+
+void AudioService::EnableSilenceSuppression(bool enable) {
+#if CONFIG_USE_UPLINK_SILENCE_SUPPRESSION
+    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
+    /* Without VAD (e.g. device AEC is on) we cannot tell silence from speech */
+    enable = enable && vad_available_;
+    if (silence_suppression_enabled_ == enable) {
+        return;
+    }
+    ESP_LOGI(TAG, "%s uplink silence suppression", enable ? "Enabling" : "Disabling");
+    silence_gate_.Reset();
+    silence_suppression_enabled_ = enable;
+#endif
+}
+
+void AudioService::SetSendQueuePolicy(SendQueuePolicy policy) {
+    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
+    if (send_queue_policy_ == policy) {
+        return;
+    }
+    ESP_LOGI(TAG, "Send queue policy: %d", policy);
+    send_queue_policy_ = policy;
+    send_queue_gap_pending_ = false;
+    audio_queue_cv_.notify_all();
+}
+
 bool AudioService::PushPacketToDecodeQueue(std::unique_ptr<AudioStreamPacket> packet, bool wait) {
     std::unique_lock<std::mutex> lock(audio_queue_mutex_);
     if (audio_decode_queue_.size() >= MAX_DECODE_PACKETS_IN_QUEUE) {
@@ -418,6 +534,7 @@ bool AudioService::PushPacketToDecodeQueue(std::unique_ptr<AudioStreamPacket> pa
             return false;
         }
     }
+    packet->payload_charge = HeapCharge(kHeapTagAudio, packet->payload.data());
     audio_decode_queue_.push_back(std::move(packet));
     audio_queue_cv_.notify_all();
     return true;
@@ -490,6 +607,18 @@ void AudioService::EnableVoiceProcessing(bool enable) {
     } else {
         audio_processor_->Stop();
         xEventGroupClearBits(event_group_, AS_EVENT_AUDIO_PROCESSOR_RUNNING);
+        if (silence_suppression_enabled_) {
+            std::lock_guard<std::mutex> lock(audio_queue_mutex_);
+            auto& stats = silence_gate_.statistics();
+            ESP_LOGI(TAG, "Silence suppression: sent %lu, suppressed %lu, dtx %lu frames, saved %ld bytes",
+                stats.frames_sent, stats.frames_suppressed, stats.dtx_frames_sent, stats.bytes_saved);
+            silence_gate_.Reset();
+        }
+        if (debug_statistics_.encode_drop_count > 0 || debug_statistics_.send_drop_count > 0) {
+            ESP_LOGI(TAG, "Uplink drops: encode %lu, send %lu, dtx markers %lu",
+                debug_statistics_.encode_drop_count, debug_statistics_.send_drop_count,
+                debug_statistics_.dtx_marker_count);
+        }
     }
 }
 
@@ -508,6 +637,16 @@ void AudioService::EnableAudioTesting(bool enable) {
 
 void AudioService::EnableDeviceAec(bool enable) {
     ESP_LOGI(TAG, "%s device AEC", enable ? "Enabling" : "Disabling");
+#if CONFIG_USE_AUDIO_PROCESSOR
+    {
+        /* The audio processor turns off VAD while device AEC is on */
+        std::lock_guard<std::mutex> lock(audio_queue_mutex_);
+        vad_available_ = !enable;
+        if (enable) {
+            silence_suppression_enabled_ = false;
+        }
+    }
+#endif
     if (!audio_processor_initialized_) {
         audio_processor_->Initialize(codec_, OPUS_FRAME_DURATION_MS, models_list_);
         audio_processor_initialized_ = true;
@@ -670,6 +809,7 @@ void AudioService::SetModelsList(srmodel_list_t* models_list) {
 
     if (wake_word_) {
         wake_word_->OnWakeWordDetected([this](const std::string& wake_word) {
+            TRACE_INSTANT(kTraceEventWakeWord);
             if (callbacks_.on_wake_word_detected) {
                 callbacks_.on_wake_word_detected(wake_word);
             }
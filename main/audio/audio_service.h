@@ -20,13 +20,15 @@
 #include "audio_codec.h"
 #include "audio_processor.h"
 #include "processors/audio_debugger.h"
+#include "uplink_controller.h"
+#include "silence_gate.h"
 #include "wake_word.h"
 #include "protocol.h"
 
 
 /*
  * There are two types of audio data flow:
- * 1. (MIC) -> [Processors] -> {Encode Queue} -> [Opus Encoder] -> {Send Queue} -> (Server)
+ * 1. (MIC) -> [Processors] -> {Encode Queue} -> [Opus Encoder] -> [Silence Gate] -> {Send Queue} -> (Server)
  * 2. (Server) -> {Decode Queue} -> [Opus Decoder] -> {Playback Queue} -> (Speaker)
  *
  * We use one task for MIC / Speaker / Processors, and one task for Opus Encoder / Opus Decoder.
@@ -42,6 +44,7 @@
 #define MAX_SEND_PACKETS_IN_QUEUE (2400 / OPUS_FRAME_DURATION_MS)
 #define AUDIO_TESTING_MAX_DURATION_MS 10000
 #define MAX_TIMESTAMPS_IN_QUEUE 3
+#define UPLINK_SILENCE_KEEPALIVE_MS 400
 
 #define AUDIO_POWER_TIMEOUT_MS 15000
 #define AUDIO_POWER_CHECK_INTERVAL_MS 1000
@@ -70,6 +73,20 @@ struct AudioTask {
     AudioTaskType type;
     std::vector<int16_t> pcm;
     uint32_t timestamp;
+    // The VAD state when the processor produced this frame, used by the silence gate
+    bool voice_detected = false;
+};
+
+/*
+ * What to do when the send queue is full:
+ * - Block: stop encoding until the queue drains, the capture task waits on the encode queue
+ * - DropOldest: discard the oldest packet in the send queue, keeps the uplink latency bounded
+ * - DropNewest: discard the new packet, a DTX marker is queued for the gap once there is room again
+ */
+enum SendQueuePolicy {
+    kSendQueuePolicyBlock,
+    kSendQueuePolicyDropOldest,
+    kSendQueuePolicyDropNewest,
 };
 
 struct DebugStatistics {
@@ -77,6 +94,9 @@ struct DebugStatistics {
     uint32_t decode_count = 0;
     uint32_t encode_count = 0;
     uint32_t playback_count = 0;
+    uint32_t encode_drop_count = 0;
+    uint32_t send_drop_count = 0;
+    uint32_t dtx_marker_count = 0;
 };
 
 class AudioService {
@@ -109,6 +129,11 @@ public:
     bool ReadAudioData(std::vector<int16_t>& data, int sample_rate, int samples);
     void ResetDecoder();
     void SetModelsList(srmodel_list_t* models_list);
+    void SetSendQueuePolicy(SendQueuePolicy policy);
+    void EnableSilenceSuppression(bool enable);
+    void ReportSendFailure() { uplink_controller_.OnSendFailed(); }
+    DebugStatistics GetDebugStatistics() const { return debug_statistics_; }
+    UplinkStatistics GetUplinkStatistics() const { return uplink_controller_.GetStatistics(); }
 
 private:
     AudioCodec* codec_ = nullptr;
@@ -122,6 +147,8 @@ private:
     OpusResampler reference_resampler_;
     OpusResampler output_resampler_;
     DebugStatistics debug_statistics_;
+    UplinkController uplink_controller_;
+    SilenceGate silence_gate_;
     srmodel_list_t* models_list_ = nullptr;
 
     EventGroupHandle_t event_group_;
@@ -145,6 +172,17 @@ private:
     bool voice_detected_ = false;
     bool service_stopped_ = true;
     bool audio_input_need_warmup_ = false;
+    SendQueuePolicy send_queue_policy_ = kSendQueuePolicyBlock;
+    bool send_queue_overflowed_ = false;
+    uint32_t send_queue_overflow_drops_ = 0;
+    bool send_queue_gap_pending_ = false;
+    uint8_t send_queue_gap_toc_ = 0;
+    bool silence_suppression_enabled_ = false;
+#if CONFIG_USE_AUDIO_PROCESSOR && !CONFIG_USE_DEVICE_AEC
+    bool vad_available_ = true;
+#else
+    bool vad_available_ = false;
+#endif
 
     esp_timer_handle_t audio_power_timer_ = nullptr;
     std::chrono::steady_clock::time_point last_input_time_;
@@ -154,6 +192,9 @@ private:
     void AudioOutputTask();
     void OpusCodecTask();
     void PushTaskToEncodeQueue(AudioTaskType type, std::vector<int16_t>&& pcm);
+    size_t PushPacketToSendQueue(std::unique_ptr<AudioStreamPacket> packet, bool voice_detected);
+    void EnqueueSendPacket(std::unique_ptr<AudioStreamPacket> packet);
+    bool CanEncodeToSendQueue() const;
     void SetDecodeSampleRate(int sample_rate, int frame_duration);
     void CheckAndUpdateAudioPowerState();
 };
@@ -52,17 +52,19 @@ AudioDebugger::~AudioDebugger() {
 }
 
 void AudioDebugger::Feed(const std::vector<int16_t>& data) {
+    Send(data.data(), data.size() * sizeof(int16_t));
+}
+
+void AudioDebugger::Send(const void* data, size_t size) {
 #if CONFIG_USE_AUDIO_DEBUGGER
     if (udp_sockfd_ >= 0) {
-        ssize_t sent = sendto(udp_sockfd_, data.data(), data.size() * sizeof(int16_t), 0,
+        ssize_t sent = sendto(udp_sockfd_, data, size, 0,
                              (struct sockaddr*)&udp_server_addr_, sizeof(udp_server_addr_));
         if (sent < 0) {
-            ESP_LOGW(TAG, "Failed to send audio data to %s: %d", CONFIG_AUDIO_DEBUG_UDP_SERVER, errno);
+            ESP_LOGW(TAG, "Failed to send data to %s: %d", CONFIG_AUDIO_DEBUG_UDP_SERVER, errno);
         } else {
-            ESP_LOGD(TAG, "Sent %d bytes audio data to %s", sent, CONFIG_AUDIO_DEBUG_UDP_SERVER);
+            ESP_LOGD(TAG, "Sent %d bytes data to %s", sent, CONFIG_AUDIO_DEBUG_UDP_SERVER);
         }
     }
 #endif
 }
-
- 
\ No newline at end of file
@@ -13,6 +13,7 @@ public:
     ~AudioDebugger();
 
     void Feed(const std::vector<int16_t>& data);
+    void Send(const void* data, size_t size);
 
 private:
     int udp_sockfd_ = -1;
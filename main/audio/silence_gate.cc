@@ -0,0 +1,74 @@
+#include "silence_gate.h"
+
+#include <esp_log.h>
+
+#define TAG "SilenceGate"
+
+
+void SilenceGate::Configure(int frame_duration_ms, int hangover_ms, int preroll_ms, int keepalive_ms) {
+    hangover_frames_ = hangover_ms / frame_duration_ms;
+    preroll_frames_ = preroll_ms / frame_duration_ms;
+    keepalive_frames_ = keepalive_ms / frame_duration_ms;
+    if (keepalive_frames_ < 1) {
+        keepalive_frames_ = 1;
+    }
+    ESP_LOGI(TAG, "Hangover %d frames, pre-roll %u frames, keepalive every %d frames",
+        hangover_frames_, preroll_frames_, keepalive_frames_);
+}
+
+void SilenceGate::Reset() {
+    preroll_.clear();
+    hangover_left_ = 0;
+    silent_frames_ = 0;
+    statistics_ = SilenceGateStatistics();
+}
+
+void SilenceGate::Process(std::unique_ptr<AudioStreamPacket> packet, bool voice_detected,
+    const std::function<void(std::unique_ptr<AudioStreamPacket>)>& output) {
+    if (voice_detected) {
+        hangover_left_ = hangover_frames_;
+    } else if (hangover_left_ > 0) {
+        hangover_left_--;
+        voice_detected = true;
+    }
+
+    if (voice_detected) {
+        while (!preroll_.empty()) {
+            output(std::move(preroll_.front()));
+            preroll_.pop_front();
+            statistics_.frames_sent++;
+        }
+        output(std::move(packet));
+        statistics_.frames_sent++;
+        silent_frames_ = 0;
+        return;
+    }
+
+    if (packet->payload.empty()) {
+        return;
+    }
+
+    preroll_.push_back(std::move(packet));
+    if (preroll_.size() <= preroll_frames_) {
+        return;
+    }
+
+    // Only the packets that fall out of the pre-roll are dropped, so the DTX frames stay in timestamp order
+    auto evicted = std::move(preroll_.front());
+    preroll_.pop_front();
+    statistics_.frames_suppressed++;
+    if (silent_frames_++ % keepalive_frames_ != 0) {
+        statistics_.bytes_saved += evicted->payload.size();
+        return;
+    }
+
+    // Code 0 with an empty frame is a DTX frame, the decoder fills it with concealment
+    auto dtx_frame = std::make_unique<AudioStreamPacket>();
+    dtx_frame->sample_rate = evicted->sample_rate;
+    dtx_frame->frame_duration = evicted->frame_duration;
+    dtx_frame->timestamp = evicted->timestamp;
+    dtx_frame->payload.push_back(evicted->payload[0] & 0xFC);
+    statistics_.dtx_frames_sent++;
+    statistics_.bytes_saved += evicted->payload.size() - dtx_frame->payload.size();
+    output(std::move(dtx_frame));
+}
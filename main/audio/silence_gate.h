@@ -0,0 +1,45 @@
+#ifndef SILENCE_GATE_H
+#define SILENCE_GATE_H
+
+#include <deque>
+#include <memory>
+#include <functional>
+#include <cstdint>
+
+#include "protocol.h"
+
+/*
+ * Uplink silence suppression driven by the VAD state:
+ * - While speaking (and during the hangover after speech ends) every packet is sent
+ * - During silence packets are held in a short pre-roll ring and dropped when it overflows,
+ *   every keepalive interval a dropped packet is replaced by a one byte DTX frame with its timestamp,
+ *   so the server keeps concealing the gap and never sees a timestamp twice
+ * - On speech onset the pre-roll ring is flushed first, so the beginning of the utterance is not lost
+ */
+
+struct SilenceGateStatistics {
+    uint32_t frames_sent = 0;
+    uint32_t frames_suppressed = 0;
+    uint32_t dtx_frames_sent = 0;
+    int32_t bytes_saved = 0;
+};
+
+class SilenceGate {
+public:
+    void Configure(int frame_duration_ms, int hangover_ms, int preroll_ms, int keepalive_ms);
+    void Reset();
+    void Process(std::unique_ptr<AudioStreamPacket> packet, bool voice_detected,
+        const std::function<void(std::unique_ptr<AudioStreamPacket>)>& output);
+    const SilenceGateStatistics& statistics() const { return statistics_; }
+
+private:
+    int hangover_frames_ = 0;
+    size_t preroll_frames_ = 0;
+    int keepalive_frames_ = 1;
+    int hangover_left_ = 0;
+    int silent_frames_ = 0;
+    std::deque<std::unique_ptr<AudioStreamPacket>> preroll_;
+    SilenceGateStatistics statistics_;
+};
+
+#endif // SILENCE_GATE_H
@@ -0,0 +1,157 @@
+#include "uplink_controller.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#define TAG "UplinkController"
+
+
+UplinkController::UplinkController() {
+#if CONFIG_USE_ADAPTIVE_UPLINK
+    min_complexity_ = CONFIG_ADAPTIVE_UPLINK_MIN_COMPLEXITY;
+    max_complexity_ = CONFIG_ADAPTIVE_UPLINK_MAX_COMPLEXITY;
+    if (max_complexity_ < min_complexity_) {
+        max_complexity_ = min_complexity_;
+    }
+#endif
+#if CONFIG_ADAPTIVE_UPLINK_ALLOW_DTX
+    allow_dtx_ = true;
+#endif
+}
+
+void UplinkController::Initialize(OpusEncoderWrapper* encoder, bool cellular, size_t max_queue_depth) {
+    encoder_ = encoder;
+    cellular_ = cellular;
+    // Cellular links react later to congestion, so we back off at a lower watermark
+    high_watermark_ = cellular ? max_queue_depth / 4 : max_queue_depth / 2;
+    window_start_us_ = 0;
+    window_max_depth_ = 0;
+    clear_windows_ = 0;
+    last_send_failures_ = send_failures_.load();
+
+    std::lock_guard<std::mutex> lock(statistics_mutex_);
+    statistics_ = UplinkStatistics();
+    statistics_.cellular = cellular;
+    statistics_.complexity = min_complexity_;
+    statistics_.dtx = allow_dtx_ && cellular;
+    encoder_->SetComplexity(statistics_.complexity);
+    encoder_->SetDtx(statistics_.dtx);
+    ESP_LOGI(TAG, "Initialized for %s link: complexity %d-%d, dtx %s, watermark %u",
+        cellular ? "cellular" : "wifi", min_complexity_, max_complexity_,
+        statistics_.dtx ? "on" : "off", high_watermark_);
+}
+
+void UplinkController::OnPacketQueued(size_t queue_depth) {
+    if (encoder_ == nullptr) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(statistics_mutex_);
+    if (queue_depth > window_max_depth_) {
+        window_max_depth_ = queue_depth;
+    }
+    if (queue_depth > statistics_.max_queue_depth) {
+        statistics_.max_queue_depth = queue_depth;
+    }
+
+    int64_t now_us = esp_timer_get_time();
+    if (window_start_us_ == 0) {
+        window_start_us_ = now_us;
+        window_idle_counter_ = GetIdleRunTimeCounter();
+        return;
+    }
+    if (now_us - window_start_us_ >= UPLINK_EVALUATE_INTERVAL_MS * 1000) {
+        Evaluate(now_us);
+    }
+}
+
+UplinkStatistics UplinkController::GetStatistics() const {
+    std::lock_guard<std::mutex> lock(statistics_mutex_);
+    return statistics_;
+}
+
+void UplinkController::Evaluate(int64_t now_us) {
+    int cpu_idle = MeasureCpuIdle(now_us);
+    uint32_t send_failures = send_failures_.load();
+    uint32_t new_failures = send_failures - last_send_failures_;
+    last_send_failures_ = send_failures;
+
+    bool congested = window_max_depth_ >= high_watermark_ || new_failures > 0;
+    int complexity = statistics_.complexity;
+    bool dtx = statistics_.dtx;
+    const char* reason = nullptr;
+
+    if (congested) {
+        clear_windows_ = 0;
+        if (allow_dtx_ && !dtx) {
+            // Stop sending full frames during silence to drain the queue faster
+            dtx = true;
+            reason = "congestion";
+        }
+    } else if (++clear_windows_ >= UPLINK_CONGESTION_CLEAR_WINDOWS) {
+        clear_windows_ = 0;
+        if (dtx && !cellular_) {
+            dtx = false;
+            reason = "link recovered";
+        }
+    }
+
+    if (cpu_idle < UPLINK_CPU_IDLE_LOW_PERCENT && complexity > min_complexity_) {
+        complexity--;
+        reason = "cpu busy";
+    } else if (!congested && cpu_idle > UPLINK_CPU_IDLE_HIGH_PERCENT && complexity < max_complexity_) {
+        complexity++;
+        reason = "cpu idle";
+    }
+
+    statistics_.congested = congested;
+    statistics_.cpu_idle_percent = cpu_idle;
+    statistics_.send_failures = send_failures;
+    if (reason != nullptr) {
+        ESP_LOGI(TAG, "Adjust (%s): complexity %d -> %d, dtx %s, queue %u/%u, failures %lu, cpu idle %d%%",
+            reason, statistics_.complexity, complexity, dtx ? "on" : "off",
+            window_max_depth_, high_watermark_, new_failures, cpu_idle);
+        Apply(complexity, dtx);
+    }
+
+    window_start_us_ = now_us;
+    window_max_depth_ = 0;
+}
+
+void UplinkController::Apply(int complexity, bool dtx) {
+    if (complexity != statistics_.complexity) {
+        encoder_->SetComplexity(complexity);
+        statistics_.complexity = complexity;
+    }
+    if (dtx != statistics_.dtx) {
+        encoder_->SetDtx(dtx);
+        statistics_.dtx = dtx;
+    }
+    statistics_.adjustments++;
+}
+
+uint32_t UplinkController::GetIdleRunTimeCounter() {
+    uint32_t counter = 0;
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+    for (int core = 0; core < CONFIG_FREERTOS_NUMBER_OF_CORES; core++) {
+        counter += ulTaskGetRunTimeCounter(xTaskGetIdleTaskHandleForCore(core));
+    }
+#endif
+    return counter;
+}
+
+int UplinkController::MeasureCpuIdle(int64_t now_us) {
+    // The run time counter is clocked by esp_timer, so both deltas are in microseconds
+    uint32_t idle_counter = GetIdleRunTimeCounter();
+    uint32_t idle_elapsed = idle_counter - window_idle_counter_;
+    window_idle_counter_ = idle_counter;
+
+    int64_t total_elapsed = (now_us - window_start_us_) * CONFIG_FREERTOS_NUMBER_OF_CORES;
+    if (total_elapsed <= 0) {
+        return statistics_.cpu_idle_percent;
+    }
+    int percent = (int)((int64_t)idle_elapsed * 100 / total_elapsed);
+    return percent > 100 ? 100 : percent;
+}
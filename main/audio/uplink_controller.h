@@ -0,0 +1,72 @@
+#ifndef UPLINK_CONTROLLER_H
+#define UPLINK_CONTROLLER_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <mutex>
+
+#include <opus_encoder.h>
+
+/*
+ * Adjusts the Opus encoder settings on the fly according to the uplink state:
+ * - Send queue depth and transport send failures tell us whether the link is congested
+ * - CPU idle time tells us whether we can afford a higher complexity
+ *
+ * The controller is driven by the opus codec task, so all encoder changes happen
+ * on the same task that does the encoding.
+ */
+
+#define UPLINK_EVALUATE_INTERVAL_MS 1000
+#define UPLINK_CONGESTION_CLEAR_WINDOWS 5
+#define UPLINK_CPU_IDLE_LOW_PERCENT 20
+#define UPLINK_CPU_IDLE_HIGH_PERCENT 50
+
+struct UplinkStatistics {
+    bool cellular = false;
+    int complexity = 0;
+    bool dtx = false;
+    bool congested = false;
+    int cpu_idle_percent = 100;
+    uint32_t max_queue_depth = 0;
+    uint32_t send_failures = 0;
+    uint32_t adjustments = 0;
+};
+
+class UplinkController {
+public:
+    UplinkController();
+
+    // Apply the initial settings to the encoder, cellular links start with DTX enabled
+    void Initialize(OpusEncoderWrapper* encoder, bool cellular, size_t max_queue_depth);
+    // Called by the codec task after a packet is pushed to the send queue
+    void OnPacketQueued(size_t queue_depth);
+    // Called by the sender when the transport refuses a packet
+    void OnSendFailed() { send_failures_++; }
+    UplinkStatistics GetStatistics() const;
+
+private:
+    OpusEncoderWrapper* encoder_ = nullptr;
+    bool cellular_ = false;
+    size_t high_watermark_ = 0;
+    int min_complexity_ = 0;
+    int max_complexity_ = 0;
+    bool allow_dtx_ = false;
+
+    int64_t window_start_us_ = 0;
+    uint32_t window_idle_counter_ = 0;
+    size_t window_max_depth_ = 0;
+    int clear_windows_ = 0;
+    std::atomic<uint32_t> send_failures_ = 0;
+    uint32_t last_send_failures_ = 0;
+    // Written by the codec task, copied out by GetStatistics() from any task
+    mutable std::mutex statistics_mutex_;
+    UplinkStatistics statistics_;
+
+    void Evaluate(int64_t now_us);
+    int MeasureCpuIdle(int64_t now_us);
+    uint32_t GetIdleRunTimeCounter();
+    void Apply(int complexity, bool dtx);
+};
+
+#endif // UPLINK_CONTROLLER_H
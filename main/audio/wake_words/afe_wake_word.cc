@@ -1,5 +1,6 @@
 #include "afe_wake_word.h"
 #include "audio_service.h"
+#include "tagged_heap.h"
 
 #include <esp_log.h>
 #include <sstream>
@@ -22,11 +23,11 @@ AfeWakeWord::~AfeWakeWord() {
     }
 
     if (wake_word_encode_task_stack_ != nullptr) {
-        heap_caps_free(wake_word_encode_task_stack_);
+        TaggedHeap::Free(kHeapTagAudio, wake_word_encode_task_stack_);
     }
 
     if (wake_word_encode_task_buffer_ != nullptr) {
-        heap_caps_free(wake_word_encode_task_buffer_);
+        TaggedHeap::Free(kHeapTagAudio, wake_word_encode_task_buffer_);
     }
 
     if (models_ != nullptr) {
@@ -160,11 +161,11 @@ void AfeWakeWord::EncodeWakeWordData() {
     const size_t stack_size = 4096 * 7;
     wake_word_opus_.clear();
     if (wake_word_encode_task_stack_ == nullptr) {
-        wake_word_encode_task_stack_ = (StackType_t*)heap_caps_malloc(stack_size, MALLOC_CAP_SPIRAM);
+        wake_word_encode_task_stack_ = (StackType_t*)TaggedHeap::Malloc(kHeapTagAudio, stack_size, MALLOC_CAP_SPIRAM);
         assert(wake_word_encode_task_stack_ != nullptr);
     }
     if (wake_word_encode_task_buffer_ == nullptr) {
-        wake_word_encode_task_buffer_ = (StaticTask_t*)heap_caps_malloc(sizeof(StaticTask_t), MALLOC_CAP_INTERNAL);
+        wake_word_encode_task_buffer_ = (StaticTask_t*)TaggedHeap::Malloc(kHeapTagAudio, sizeof(StaticTask_t), MALLOC_CAP_INTERNAL);
         assert(wake_word_encode_task_buffer_ != nullptr);
     }
 
@@ -2,6 +2,8 @@
 #include "audio_service.h"
 #include "system_info.h"
 #include "assets.h"
+#include "json_arena.h"
+#include "tagged_heap.h"
 
 #include <esp_log.h>
 #include <esp_mn_iface.h>
@@ -24,11 +26,11 @@ CustomWakeWord::~CustomWakeWord() {
     }
 
     if (wake_word_encode_task_stack_ != nullptr) {
-        heap_caps_free(wake_word_encode_task_stack_);
+        TaggedHeap::Free(kHeapTagAudio, wake_word_encode_task_stack_);
     }
 
     if (wake_word_encode_task_buffer_ != nullptr) {
-        heap_caps_free(wake_word_encode_task_buffer_);
+        TaggedHeap::Free(kHeapTagAudio, wake_word_encode_task_buffer_);
     }
 
     if (models_ != nullptr) {
@@ -45,6 +47,7 @@ void CustomWakeWord::ParseWakenetModelConfig() {
         ESP_LOGE(TAG, "Failed to read index.json");
         return;
     }
+    JsonArenaScope arena("wakenet");
     cJSON* root = cJSON_ParseWithLength(static_cast<char*>(ptr), size);
     if (root == nullptr) {
         ESP_LOGE(TAG, "Failed to parse index.json");
@@ -206,11 +209,11 @@ void CustomWakeWord::EncodeWakeWordData() {
     const size_t stack_size = 4096 * 7;
     wake_word_opus_.clear();
     if (wake_word_encode_task_stack_ == nullptr) {
-        wake_word_encode_task_stack_ = (StackType_t*)heap_caps_malloc(stack_size, MALLOC_CAP_SPIRAM);
+        wake_word_encode_task_stack_ = (StackType_t*)TaggedHeap::Malloc(kHeapTagAudio, stack_size, MALLOC_CAP_SPIRAM);
         assert(wake_word_encode_task_stack_ != nullptr);
     }
     if (wake_word_encode_task_buffer_ == nullptr) {
-        wake_word_encode_task_buffer_ = (StaticTask_t*)heap_caps_malloc(sizeof(StaticTask_t), MALLOC_CAP_INTERNAL);
+        wake_word_encode_task_buffer_ = (StaticTask_t*)TaggedHeap::Malloc(kHeapTagAudio, sizeof(StaticTask_t), MALLOC_CAP_INTERNAL);
         assert(wake_word_encode_task_buffer_ != nullptr);
     }
 
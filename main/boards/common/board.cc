@@ -4,6 +4,7 @@
 #include "display/display.h"
 #include "display/oled_display.h"
 #include "assets/lang_config.h"
+#include "json_writer.h"
 
 #include <esp_log.h>
 #include <esp_ota_ops.h>
@@ -107,72 +108,72 @@ std::string Board::GetSystemInfoJson() {
             }
         }
     */
-    std::string json = R"({"version":2,"language":")" + std::string(Lang::CODE) + R"(",)";
-    json += R"("flash_size":)" + std::to_string(SystemInfo::GetFlashSize()) + R"(,)";
-    json += R"("minimum_free_heap_size":")" + std::to_string(SystemInfo::GetMinimumFreeHeapSize()) + R"(",)";
-    json += R"("mac_address":")" + SystemInfo::GetMacAddress() + R"(",)";
-    json += R"("uuid":")" + uuid_ + R"(",)";
-    json += R"("chip_model_name":")" + SystemInfo::GetChipModelName() + R"(",)";
+    std::string json;
+    JsonWriter writer(json, 2048);
+    writer.BeginObject();
+    writer.Key("version").Int(2);
+    writer.Key("language").String(Lang::CODE);
+    writer.Key("flash_size").Int(SystemInfo::GetFlashSize());
+    writer.Key("minimum_free_heap_size").String(std::to_string(SystemInfo::GetMinimumFreeHeapSize()));
+    writer.Key("mac_address").String(SystemInfo::GetMacAddress());
+    writer.Key("uuid").String(uuid_);
+    writer.Key("chip_model_name").String(SystemInfo::GetChipModelName());
 
     esp_chip_info_t chip_info;
     esp_chip_info(&chip_info);
-    json += R"("chip_info":{)";
-    json += R"("model":)" + std::to_string(chip_info.model) + R"(,)";
-    json += R"("cores":)" + std::to_string(chip_info.cores) + R"(,)";
-    json += R"("revision":)" + std::to_string(chip_info.revision) + R"(,)";
-    json += R"("features":)" + std::to_string(chip_info.features) + R"(},)";
+    writer.Key("chip_info").BeginObject();
+    writer.Key("model").Int(chip_info.model);
+    writer.Key("cores").Int(chip_info.cores);
+    writer.Key("revision").Int(chip_info.revision);
+    writer.Key("features").Int(chip_info.features);
+    writer.EndObject();
 
     auto app_desc = esp_app_get_description();
-    json += R"("application":{)";
-    json += R"("name":")" + std::string(app_desc->project_name) + R"(",)";
-    json += R"("version":")" + std::string(app_desc->version) + R"(",)";
-    json += R"("compile_time":")" + std::string(app_desc->date) + R"(T)" + std::string(app_desc->time) + R"(Z",)";
-    json += R"("idf_version":")" + std::string(app_desc->idf_ver) + R"(",)";
+    char compile_time[48];
+    snprintf(compile_time, sizeof(compile_time), "%sT%sZ", app_desc->date, app_desc->time);
     char sha256_str[65];
     for (int i = 0; i < 32; i++) {
         snprintf(sha256_str + i * 2, sizeof(sha256_str) - i * 2, "%02x", app_desc->app_elf_sha256[i]);
     }
-    json += R"("elf_sha256":")" + std::string(sha256_str) + R"(")";
-    json += R"(},)";
-
-    json += R"("partition_table": [)";
+    writer.Key("application").BeginObject();
+    writer.Key("name").String(app_desc->project_name);
+    writer.Key("version").String(app_desc->version);
+    writer.Key("compile_time").String(compile_time);
+    writer.Key("idf_version").String(app_desc->idf_ver);
+    writer.Key("elf_sha256").String(sha256_str);
+    writer.EndObject();
+
+    writer.Key("partition_table").BeginArray();
     esp_partition_iterator_t it = esp_partition_find(ESP_PARTITION_TYPE_ANY, ESP_PARTITION_SUBTYPE_ANY, NULL);
     while (it) {
         const esp_partition_t *partition = esp_partition_get(it);
-        json += R"({)";
-        json += R"("label":")" + std::string(partition->label) + R"(",)";
-        json += R"("type":)" + std::to_string(partition->type) + R"(,)";
-        json += R"("subtype":)" + std::to_string(partition->subtype) + R"(,)";
-        json += R"("address":)" + std::to_string(partition->address) + R"(,)";
-        json += R"("size":)" + std::to_string(partition->size) + R"(},)";;
+        writer.BeginObject();
+        writer.Key("label").String(partition->label);
+        writer.Key("type").Int(partition->type);
+        writer.Key("subtype").Int(partition->subtype);
+        writer.Key("address").Int(partition->address);
+        writer.Key("size").Int(partition->size);
+        writer.EndObject();
         it = esp_partition_next(it);
     }
-    json.pop_back(); // Remove the last comma
-    json += R"(],)";
+    writer.EndArray();
 
-    json += R"("ota":{)";
     auto ota_partition = esp_ota_get_running_partition();
-    json += R"("label":")" + std::string(ota_partition->label) + R"(")";
-    json += R"(},)";
+    writer.Key("ota").BeginObject();
+    writer.Key("label").String(ota_partition->label);
+    writer.EndObject();
 
     // Append display info
     auto display = GetDisplay();
     if (display) {
-        json += R"("display":{)";
-        if (dynamic_cast<OledDisplay*>(display)) {
-            json += R"("monochrome":)" + std::string("true") + R"(,)";
-        } else {
-            json += R"("monochrome":)" + std::string("false") + R"(,)";
-        }
-        json += R"("width":)" + std::to_string(display->width()) + R"(,)";
-        json += R"("height":)" + std::to_string(display->height()) + R"(,)";
-        json.pop_back(); // Remove the last comma
+        writer.Key("display").BeginObject();
+        writer.Key("monochrome").Bool(dynamic_cast<OledDisplay*>(display) != nullptr);
+        writer.Key("width").Int(display->width());
+        writer.Key("height").Int(display->height());
+        writer.EndObject();
     }
-    json += R"(},)";
-
-    json += R"("board":)" + GetBoardJson();
 
-    // Close the JSON object
-    json += R"(})";
+    writer.Key("board").Raw(GetBoardJson());
+    writer.EndObject();
     return json;
 }
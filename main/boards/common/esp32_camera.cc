@@ -4,6 +4,7 @@
 #include <sys/mman.h>
 #include <sys/param.h>
 #include <unistd.h>
+#include <esp_timer.h>
 #include "board.h"
 #include "display.h"
 #include "esp_imgfx_color_convert.h"
@@ -14,6 +15,7 @@
 #include "lvgl_display.h"
 #include "mcp_server.h"
 #include "system_info.h"
+#include "tagged_heap.h"
 
 #ifdef CONFIG_XIAOZHI_ENABLE_CAMERA_DEBUG_MODE
 #undef LOG_LOCAL_LEVEL
@@ -356,6 +358,16 @@ Esp32Camera::Esp32Camera(const esp_video_init_config_t& config) {
 }
 
 Esp32Camera::~Esp32Camera() {
+    if (encoder_thread_.joinable()) {
+        encoder_thread_.join();
+    }
+    ReturnLentBuffer();
+    for (auto& b : frame_pool_) {
+        if (b.data) {
+            TaggedHeap::Free(kHeapTagCamera, b.data);
+            b = {};
+        }
+    }
     if (streaming_on_ && video_fd_ >= 0) {
         int type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
         ioctl(video_fd_, VIDIOC_STREAMOFF, &type);
@@ -373,6 +385,45 @@ Esp32Camera::~Esp32Camera() {
     esp_video_deinit();
 }
 
+uint8_t* Esp32Camera::AcquireFrameBuffer(size_t size) {
+    // Aligned and padded to 128 bytes, the largest cache line, so PPA and DMA can use the buffers
+    size = (size + 127) & ~(size_t)127;
+    // The buffer that holds the frame right now is never handed out
+    auto& b = frame_pool_[0].data != nullptr && frame_pool_[0].data == frame_.data ? frame_pool_[1] : frame_pool_[0];
+    if (b.size < size) {
+        if (b.data) {
+            TaggedHeap::Free(kHeapTagCamera, b.data);
+            b = {};
+        }
+        b.data = (uint8_t*)TaggedHeap::AlignedAlloc(kHeapTagCamera, 128, size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (b.data == nullptr) {
+            return nullptr;
+        }
+        b.size = size;
+        capture_allocations_++;
+    }
+    return b.data;
+}
+
+void Esp32Camera::ReturnLentBuffer() {
+    if (lent_buffer_index_ < 0) {
+        return;
+    }
+    if (frame_.data == mmap_buffers_[lent_buffer_index_].start) {
+        frame_.data = nullptr;
+        frame_.len = 0;
+        frame_.format = 0;
+    }
+    struct v4l2_buffer buf = {};
+    buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buf.memory = V4L2_MEMORY_MMAP;
+    buf.index = lent_buffer_index_;
+    if (ioctl(video_fd_, VIDIOC_QBUF, &buf) != 0) {
+        ESP_LOGE(TAG, "VIDIOC_QBUF of the lent buffer failed");
+    }
+    lent_buffer_index_ = -1;
+}
+
 void Esp32Camera::SetExplainUrl(const std::string& url, const std::string& token) {
     explain_url_ = url;
     explain_token_ = token;
@@ -382,10 +433,14 @@ bool Esp32Camera::Capture() {
     if (encoder_thread_.joinable()) {
         encoder_thread_.join();
     }
+    // Normally given back by Explain already, a frame that was never explained still holds its buffer
+    ReturnLentBuffer();
 
     if (!streaming_on_ || video_fd_ < 0) {
         return false;
     }
+    capture_start_us_ = esp_timer_get_time();
+    capture_allocations_ = 0;
 
     for (int i = 0; i < 3; i++) {
         struct v4l2_buffer buf = {};
@@ -396,14 +451,23 @@ bool Esp32Camera::Capture() {
             return false;
         }
         if (i == 2) {
-            // 保存帧副本到PSRAM
-            if (frame_.data) {
-                heap_caps_free(frame_.data);
-                frame_.data = nullptr;
-                frame_.format = 0;
-            }
+            frame_.format = 0;
             frame_.len = buf.bytesused;
-            frame_.data = (uint8_t*)heap_caps_malloc(frame_.len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+            bool lend = false;
+#if !defined(CONFIG_XIAOZHI_ENABLE_CAMERA_ENDIANNESS_SWAP) && !defined(CONFIG_XIAOZHI_ENABLE_ROTATE_CAMERA_IMAGE)
+            // Formats used as they are hand the mmapped buffer to the encoder and preview without a copy,
+            // it is queued again on the next capture. With a single buffer the sensor would stall meanwhile
+            lend = mmap_buffers_.size() > 1 &&
+                   (sensor_format_ == V4L2_PIX_FMT_RGB565 || sensor_format_ == V4L2_PIX_FMT_RGB24 ||
+                    sensor_format_ == V4L2_PIX_FMT_YUYV || sensor_format_ == V4L2_PIX_FMT_YUV420 ||
+                    sensor_format_ == V4L2_PIX_FMT_GREY || sensor_format_ == V4L2_PIX_FMT_YUV422P);
+#endif
+            if (lend) {
+                frame_.data = (uint8_t*)mmap_buffers_[buf.index].start;
+            } else {
+                // 保存帧副本到PSRAM
+                frame_.data = AcquireFrameBuffer(frame_.len);
+            }
             if (!frame_.data) {
                 ESP_LOGE(TAG, "alloc frame copy failed");
                 if (ioctl(video_fd_, VIDIOC_QBUF, &buf) != 0) {
@@ -438,8 +502,10 @@ bool Esp32Camera::Capture() {
                     }
                 }
 #else
-                    memcpy(frame_.data, mmap_buffers_[buf.index].start,
-                           MIN(mmap_buffers_[buf.index].length, frame_.len));
+                    if (!lend) {
+                        memcpy(frame_.data, mmap_buffers_[buf.index].start,
+                               MIN(mmap_buffers_[buf.index].length, frame_.len));
+                    }
 #endif  // CONFIG_XIAOZHI_ENABLE_CAMERA_ENDIANNESS_SWAP
                     frame_.format = sensor_format_;
                     break;
@@ -456,8 +522,10 @@ bool Esp32Camera::Capture() {
                         }
                     }
 #else
-                    memcpy(frame_.data, mmap_buffers_[buf.index].start,
-                           MIN(mmap_buffers_[buf.index].length, frame_.len));
+                    if (!lend) {
+                        memcpy(frame_.data, mmap_buffers_[buf.index].start,
+                               MIN(mmap_buffers_[buf.index].length, frame_.len));
+                    }
 #endif  // CONFIG_XIAOZHI_ENABLE_CAMERA_ENDIANNESS_SWAP
                     break;
                 }
@@ -483,8 +551,7 @@ bool Esp32Camera::Capture() {
 
 #ifdef CONFIG_XIAOZHI_ENABLE_ROTATE_CAMERA_IMAGE
 #ifndef CONFIG_SOC_PPA_SUPPORTED
-            uint8_t* rotate_dst =
-                (uint8_t*)heap_caps_aligned_alloc(64, frame_.len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+            uint8_t* rotate_dst = AcquireFrameBuffer(frame_.len);
             if (rotate_dst == nullptr) {
                 ESP_LOGE(TAG, "Failed to allocate memory for rotate image");
                 if (ioctl(video_fd_, VIDIOC_QBUF, &buf) != 0) {
@@ -544,8 +611,6 @@ bool Esp32Camera::Capture() {
             imgfx_err = esp_imgfx_rotate_process(rotate_handle, &rotate_input_data, &rotate_output_data);
             if (imgfx_err != ESP_IMGFX_ERR_OK) {
                 ESP_LOGE(TAG, "esp_imgfx_rotate_process failed");
-                heap_caps_free(rotate_dst);
-                rotate_dst = nullptr;
                 if (ioctl(video_fd_, VIDIOC_QBUF, &buf) != 0) {
                     ESP_LOGE(TAG, "Cleanup: VIDIOC_QBUF failed");
                 }
@@ -556,9 +621,6 @@ bool Esp32Camera::Capture() {
 
             frame_.data = rotate_dst;
 
-            heap_caps_free(rotate_src);
-            rotate_src = nullptr;
-
             esp_imgfx_rotate_close(rotate_handle);
             rotate_handle = nullptr;
 #else   // CONFIG_SOC_PPA_SUPPORTED
@@ -576,8 +638,7 @@ bool Esp32Camera::Capture() {
                     break;
                 case V4L2_PIX_FMT_YUYV: {
                     ESP_LOGW(TAG, "YUYV format is not supported for PPA rotation, using software conversion to RGB888");
-                    rotate_src = (uint8_t*)heap_caps_malloc(frame_.width * frame_.height * 3,
-                                                            MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+                    rotate_src = AcquireFrameBuffer(frame_.width * frame_.height * 3);
                     if (rotate_src == nullptr) {
                         ESP_LOGE(TAG, "Failed to allocate memory for rotate image");
                         if (ioctl(video_fd_, VIDIOC_QBUF, &buf) != 0) {
@@ -595,8 +656,6 @@ bool Esp32Camera::Capture() {
                     esp_imgfx_err_t err = esp_imgfx_color_convert_open(&convert_cfg, &convert_handle);
                     if (err != ESP_IMGFX_ERR_OK || convert_handle == nullptr) {
                         ESP_LOGE(TAG, "esp_imgfx_color_convert_open failed");
-                        heap_caps_free(rotate_src);
-                        rotate_src = nullptr;
                         if (ioctl(video_fd_, VIDIOC_QBUF, &buf) != 0) {
                             ESP_LOGE(TAG, "Cleanup: VIDIOC_QBUF failed");
                         }
@@ -613,8 +672,6 @@ bool Esp32Camera::Capture() {
                     err = esp_imgfx_color_convert_process(convert_handle, &convert_input_data, &convert_output_data);
                     if (err != ESP_IMGFX_ERR_OK) {
                         ESP_LOGE(TAG, "esp_imgfx_color_convert_process failed");
-                        heap_caps_free(rotate_src);
-                        rotate_src = nullptr;
                         esp_imgfx_color_convert_close(convert_handle);
                         convert_handle = nullptr;
                         if (ioctl(video_fd_, VIDIOC_QBUF, &buf) != 0) {
@@ -625,7 +682,6 @@ bool Esp32Camera::Capture() {
                     esp_imgfx_color_convert_close(convert_handle);
                     convert_handle = nullptr;
                     ppa_color_mode = PPA_SRM_COLOR_MODE_RGB888;
-                    heap_caps_free(frame_.data);
                     frame_.data = rotate_src;
                     frame_.len = frame_.width * frame_.height * 3;
                     break;
@@ -638,8 +694,7 @@ bool Esp32Camera::Capture() {
                     return false;
             }
 
-            uint8_t* rotate_dst = (uint8_t*)heap_caps_malloc(
-                frame_.width * frame_.height * 2, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT | MALLOC_CAP_CACHE_ALIGNED);
+            uint8_t* rotate_dst = AcquireFrameBuffer(frame_.width * frame_.height * 2);
             if (rotate_dst == nullptr) {
                 ESP_LOGE(TAG, "Failed to allocate memory for rotate image");
                 if (ioctl(video_fd_, VIDIOC_QBUF, &buf) != 0) {
@@ -656,8 +711,6 @@ bool Esp32Camera::Capture() {
             esp_err_t err = ppa_register_client(&client_cfg, &ppa_client);
             if (err != ESP_OK || ppa_client == nullptr) {
                 ESP_LOGE(TAG, "ppa_register_client failed: %d", (int)err);
-                heap_caps_free(rotate_dst);
-                rotate_dst = nullptr;
                 if (ioctl(video_fd_, VIDIOC_QBUF, &buf) != 0) {
                     ESP_LOGE(TAG, "Cleanup: VIDIOC_QBUF failed");
                 }
@@ -694,8 +747,6 @@ bool Esp32Camera::Capture() {
             err = ppa_do_scale_rotate_mirror(ppa_client, &srm_cfg);
             if (err != ESP_OK) {
                 ESP_LOGE(TAG, "ppa_do_scale_rotate_mirror failed: %d", (int)err);
-                heap_caps_free(rotate_dst);
-                rotate_dst = nullptr;
                 (void)ppa_unregister_client(ppa_client);
                 if (ioctl(video_fd_, VIDIOC_QBUF, &buf) != 0) {
                     ESP_LOGE(TAG, "Cleanup: VIDIOC_QBUF failed");
@@ -708,13 +759,13 @@ bool Esp32Camera::Capture() {
             frame_.data = rotate_dst;
             frame_.len = frame_.width * frame_.height * 2;
             frame_.format = V4L2_PIX_FMT_RGB565;
-            heap_caps_free(rotate_src);
-            rotate_src = nullptr;
 #endif  // CONFIG_SOC_PPA_SUPPORTED
 #endif  // CONFIG_XIAOZHI_ENABLE_ROTATE_CAMERA_IMAGE
         }
 
-        if (ioctl(video_fd_, VIDIOC_QBUF, &buf) != 0) {
+        if (i == 2 && frame_.data == mmap_buffers_[buf.index].start) {
+            lent_buffer_index_ = buf.index;
+        } else if (ioctl(video_fd_, VIDIOC_QBUF, &buf) != 0) {
             ESP_LOGE(TAG, "VIDIOC_QBUF failed");
         }
     }
@@ -739,11 +790,13 @@ bool Esp32Camera::Capture() {
             case V4L2_PIX_FMT_YUV420:
             case V4L2_PIX_FMT_RGB24: {
                 color_format = LV_COLOR_FORMAT_RGB565;
-                data = (uint8_t*)heap_caps_malloc(w * h * 2, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+                data = (uint8_t*)TaggedHeap::Malloc(kHeapTagCamera, w * h * 2, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
                 if (data == nullptr) {
                     ESP_LOGE(TAG, "Failed to allocate memory for preview image");
+                    ReturnLentBuffer();
                     return false;
                 }
+                capture_allocations_++;
                 esp_imgfx_color_convert_cfg_t convert_cfg = {
                     .in_res = {.width = static_cast<int16_t>(frame_.width),
                                .height = static_cast<int16_t>(frame_.height)},
@@ -755,8 +808,9 @@ bool Esp32Camera::Capture() {
                 esp_imgfx_err_t err = esp_imgfx_color_convert_open(&convert_cfg, &convert_handle);
                 if (err != ESP_IMGFX_ERR_OK || convert_handle == nullptr) {
                     ESP_LOGE(TAG, "esp_imgfx_color_convert_open failed");
-                    heap_caps_free(data);
+                    TaggedHeap::Free(kHeapTagCamera, data);
                     data = nullptr;
+                    ReturnLentBuffer();
                     return false;
                 }
                 esp_imgfx_data_t convert_input_data = {
@@ -770,10 +824,11 @@ bool Esp32Camera::Capture() {
                 err = esp_imgfx_color_convert_process(convert_handle, &convert_input_data, &convert_output_data);
                 if (err != ESP_IMGFX_ERR_OK) {
                     ESP_LOGE(TAG, "esp_imgfx_color_convert_process failed");
-                    heap_caps_free(data);
+                    TaggedHeap::Free(kHeapTagCamera, data);
                     data = nullptr;
                     esp_imgfx_color_convert_close(convert_handle);
                     convert_handle = nullptr;
+                    ReturnLentBuffer();
                     return false;
                 }
                 esp_imgfx_color_convert_close(convert_handle);
@@ -783,23 +838,31 @@ bool Esp32Camera::Capture() {
             }
 
             case V4L2_PIX_FMT_RGB565:
-                data = (uint8_t*)heap_caps_malloc(w * h * 2, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+                data = (uint8_t*)TaggedHeap::Malloc(kHeapTagCamera, w * h * 2, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
                 if (data == nullptr) {
                     ESP_LOGE(TAG, "Failed to allocate memory for preview image");
+                    ReturnLentBuffer();
                     return false;
                 }
+                capture_allocations_++;
                 memcpy(data, frame_.data, frame_.len);
                 lvgl_image_size = frame_.len;  // fallthrough 时兼顾 YUYV 与 RGB565
                 break;
 
             default:
                 ESP_LOGE(TAG, "unsupported frame format: 0x%08lx", frame_.format);
+                ReturnLentBuffer();
                 return false;
         }
 
+        // The preview image owns the buffer from now on
+        TaggedHeap::Transfer(kHeapTagCamera, kHeapTagDisplay, data);
         auto image = std::make_unique<LvglAllocatedImage>(data, lvgl_image_size, w, h, stride, color_format);
         display->SetPreviewImage(std::move(image));
     }
+    ESP_LOGI(TAG, "Captured %ux%u in %lld ms, %lu allocations, %s", frame_.width, frame_.height,
+             (esp_timer_get_time() - capture_start_us_) / 1000, capture_allocations_,
+             lent_buffer_index_ >= 0 ? "zero copy" : "copied");
     return true;
 }
 
@@ -864,6 +927,10 @@ std::string Esp32Camera::Explain(const std::string& question) {
     if (explain_url_.empty()) {
         throw std::runtime_error("Image explain URL or token is not set");
     }
+    // A lent frame is given back to the driver once it is encoded, explaining it again needs a new Capture
+    if (frame_.data == nullptr) {
+        throw std::runtime_error("No frame captured");
+    }
 
     // 创建局部的 JPEG 队列, 40 entries is about to store 512 * 40 = 20480 bytes of JPEG data
     QueueHandle_t jpeg_queue = xQueueCreate(40, sizeof(JpegChunk));
@@ -877,16 +944,22 @@ std::string Esp32Camera::Explain(const std::string& question) {
         uint16_t w = frame_.width ? frame_.width : 320;
         uint16_t h = frame_.height ? frame_.height : 240;
         v4l2_pix_fmt_t enc_fmt = frame_.format;
-        image_to_jpeg_cb(
+        bool ok = image_to_jpeg_cb(
             frame_.data, frame_.len, w, h, enc_fmt, 80,
             [](void* arg, size_t index, const void* data, size_t len) -> size_t {
                 auto jpeg_queue = (QueueHandle_t)arg;
-                JpegChunk chunk = {.data = (uint8_t*)heap_caps_aligned_alloc(16, len, MALLOC_CAP_SPIRAM), .len = len};
+                JpegChunk chunk = {.data = (uint8_t*)TaggedHeap::AlignedAlloc(kHeapTagCamera, 16, len, MALLOC_CAP_SPIRAM), .len = len};
                 memcpy(chunk.data, data, len);
                 xQueueSend(jpeg_queue, &chunk, portMAX_DELAY);
                 return len;
             },
             jpeg_queue);
+        ESP_LOGI(TAG, "Capture to JPEG took %lld ms", (esp_timer_get_time() - capture_start_us_) / 1000);
+        if (!ok) {
+            // The encoder only ends the stream on success, end it here so the reader does not wait forever
+            JpegChunk chunk = {.data = nullptr, .len = 0};
+            xQueueSend(jpeg_queue, &chunk, portMAX_DELAY);
+        }
     });
 
     auto network = Board::GetInstance().GetNetwork();
@@ -904,16 +977,17 @@ std::string Esp32Camera::Explain(const std::string& question) {
     http->SetHeader("Transfer-Encoding", "chunked");
     if (!http->Open("POST", explain_url_)) {
         ESP_LOGE(TAG, "Failed to connect to explain URL");
-        // Clear the queue
-        encoder_thread_.join();
+        // Clear the queue before joining, the encoder streams one chunk per MCU row stripe and may be waiting for room
         JpegChunk chunk;
         while (xQueueReceive(jpeg_queue, &chunk, portMAX_DELAY) == pdPASS) {
             if (chunk.data != nullptr) {
-                heap_caps_free(chunk.data);
+                TaggedHeap::Free(kHeapTagCamera, chunk.data);
             } else {
                 break;
             }
         }
+        encoder_thread_.join();
+        ReturnLentBuffer();
         vQueueDelete(jpeg_queue);
         throw std::runtime_error("Failed to connect to explain URL");
     }
@@ -939,6 +1013,7 @@ std::string Esp32Camera::Explain(const std::string& question) {
 
     // 第三块：JPEG数据
     size_t total_sent = 0;
+    bool cancelled = false;
     while (true) {
         JpegChunk chunk;
         if (xQueueReceive(jpeg_queue, &chunk, portMAX_DELAY) != pdPASS) {
@@ -948,14 +1023,27 @@ std::string Esp32Camera::Explain(const std::string& question) {
         if (chunk.data == nullptr) {
             break;  // The last chunk
         }
-        http->Write((const char*)chunk.data, chunk.len);
-        total_sent += chunk.len;
-        heap_caps_free(chunk.data);
+        // A cancelled or timed out MCP call stops uploading, the rest of the chunks are only drained
+        if (!cancelled && McpServer::GetInstance().IsCallCancelled()) {
+            ESP_LOGW(TAG, "Explain cancelled after %u bytes", total_sent);
+            cancelled = true;
+        }
+        if (!cancelled) {
+            http->Write((const char*)chunk.data, chunk.len);
+            total_sent += chunk.len;
+        }
+        TaggedHeap::Free(kHeapTagCamera, chunk.data);
     }
-    // Wait for the encoder thread to finish
+    // Wait for the encoder thread to finish, then queue the frame's V4L2 buffer back right away
     encoder_thread_.join();
+    size_t frame_len = frame_.len;
+    ReturnLentBuffer();
     // 清理队列
     vQueueDelete(jpeg_queue);
+    if (cancelled) {
+        http->Close();
+        throw std::runtime_error("Explain cancelled");
+    }
 
     {
         // 第四块：multipart尾部
@@ -977,6 +1065,6 @@ std::string Esp32Camera::Explain(const std::string& question) {
     // Get remain task stack size
     size_t remain_stack_size = uxTaskGetStackHighWaterMark(nullptr);
     ESP_LOGI(TAG, "Explain image size=%d bytes, compressed size=%d, remain stack size=%d, question=%s\n%s",
-             (int)frame_.len, (int)total_sent, (int)remain_stack_size, question.c_str(), result.c_str());
+             (int)frame_len, (int)total_sent, (int)remain_stack_size, question.c_str(), result.c_str());
     return result;
 }
@@ -14,11 +14,6 @@
 #include "jpg/image_to_jpeg.h"
 #include "esp_video_init.h"
 
-struct JpegChunk {
-    uint8_t* data;
-    size_t len;
-};
-
 class Esp32Camera : public Camera {
 private:
     struct FrameBuffer {
@@ -37,10 +32,20 @@ private:
     bool streaming_on_ = false;
     struct MmapBuffer { void *start = nullptr; size_t length = 0; };
     std::vector<MmapBuffer> mmap_buffers_;
+    // Frame copies and rotation targets alternate between two buffers that only grow
+    struct PoolBuffer { uint8_t *data = nullptr; size_t size = 0; };
+    PoolBuffer frame_pool_[2];
+    // The V4L2 buffer frame_.data points at, queued back on the next capture
+    int lent_buffer_index_ = -1;
+    uint32_t capture_allocations_ = 0;
+    int64_t capture_start_us_ = 0;
     std::string explain_url_;
     std::string explain_token_;
     std::thread encoder_thread_;
 
+    uint8_t* AcquireFrameBuffer(size_t size);
+    void ReturnLentBuffer();
+
 public:
     Esp32Camera(const esp_video_init_config_t& config);
     ~Esp32Camera();
@@ -3,6 +3,7 @@
 #include "application.h"
 #include "display.h"
 #include "assets/lang_config.h"
+#include "json_writer.h"
 
 #include <esp_log.h>
 #include <esp_timer.h>
@@ -95,14 +96,18 @@ const char* Ml307Board::GetNetworkStateIcon() {
 
 std::string Ml307Board::GetBoardJson() {
     // Set the board type for OTA
-    std::string board_json = std::string("{\"type\":\"" BOARD_TYPE "\",");
-    board_json += "\"name\":\"" BOARD_NAME "\",";
-    board_json += "\"revision\":\"" + modem_->GetModuleRevision() + "\",";
-    board_json += "\"carrier\":\"" + modem_->GetCarrierName() + "\",";
-    board_json += "\"csq\":\"" + std::to_string(modem_->GetCsq()) + "\",";
-    board_json += "\"imei\":\"" + modem_->GetImei() + "\",";
-    board_json += "\"iccid\":\"" + modem_->GetIccid() + "\",";
-    board_json += "\"cereg\":" + modem_->GetRegistrationState().ToString() + "}";
+    std::string board_json;
+    JsonWriter writer(board_json, 256);
+    writer.BeginObject();
+    writer.Key("type").String(BOARD_TYPE);
+    writer.Key("name").String(BOARD_NAME);
+    writer.Key("revision").String(modem_->GetModuleRevision());
+    writer.Key("carrier").String(modem_->GetCarrierName());
+    writer.Key("csq").String(std::to_string(modem_->GetCsq()));
+    writer.Key("imei").String(modem_->GetImei());
+    writer.Key("iccid").String(modem_->GetIccid());
+    writer.Key("cereg").Raw(modem_->GetRegistrationState().ToString());
+    writer.EndObject();
     return board_json;
 }
 
@@ -135,63 +140,62 @@ std::string Ml307Board::GetDeviceStatusJson() {
      * }
      */
     auto& board = Board::GetInstance();
-    auto root = cJSON_CreateObject();
+    std::string json;
+    JsonWriter writer(json, 256);
+    writer.BeginObject();
 
     // Audio speaker
-    auto audio_speaker = cJSON_CreateObject();
+    writer.Key("audio_speaker").BeginObject();
     auto audio_codec = board.GetAudioCodec();
     if (audio_codec) {
-        cJSON_AddNumberToObject(audio_speaker, "volume", audio_codec->output_volume());
+        writer.Key("volume").Int(audio_codec->output_volume());
     }
-    cJSON_AddItemToObject(root, "audio_speaker", audio_speaker);
+    writer.EndObject();
 
     // Screen brightness
+    writer.Key("screen").BeginObject();
     auto backlight = board.GetBacklight();
-    auto screen = cJSON_CreateObject();
     if (backlight) {
-        cJSON_AddNumberToObject(screen, "brightness", backlight->brightness());
+        writer.Key("brightness").Int(backlight->brightness());
     }
     auto display = board.GetDisplay();
     if (display && display->height() > 64) { // For LCD display only
         auto theme = display->GetTheme();
         if (theme != nullptr) {
-            cJSON_AddStringToObject(screen, "theme", theme->name().c_str());
+            writer.Key("theme").String(theme->name());
         }
     }
-    cJSON_AddItemToObject(root, "screen", screen);
+    writer.EndObject();
 
     // Battery
     int battery_level = 0;
     bool charging = false;
     bool discharging = false;
     if (board.GetBatteryLevel(battery_level, charging, discharging)) {
-        cJSON* battery = cJSON_CreateObject();
-        cJSON_AddNumberToObject(battery, "level", battery_level);
-        cJSON_AddBoolToObject(battery, "charging", charging);
-        cJSON_AddItemToObject(root, "battery", battery);
+        writer.Key("battery").BeginObject();
+        writer.Key("level").Int(battery_level);
+        writer.Key("charging").Bool(charging);
+        writer.EndObject();
     }
 
     // Network
-    auto network = cJSON_CreateObject();
-    cJSON_AddStringToObject(network, "type", "cellular");
-    cJSON_AddStringToObject(network, "carrier", modem_->GetCarrierName().c_str());
+    writer.Key("network").BeginObject();
+    writer.Key("type").String("cellular");
+    writer.Key("carrier").String(modem_->GetCarrierName());
     int csq = modem_->GetCsq();
     if (csq == -1) {
-        cJSON_AddStringToObject(network, "signal", "unknown");
+        writer.Key("signal").String("unknown");
     } else if (csq >= 0 && csq <= 14) {
-        cJSON_AddStringToObject(network, "signal", "very weak");
+        writer.Key("signal").String("very weak");
     } else if (csq >= 15 && csq <= 19) {
-        cJSON_AddStringToObject(network, "signal", "weak");
+        writer.Key("signal").String("weak");
     } else if (csq >= 20 && csq <= 24) {
-        cJSON_AddStringToObject(network, "signal", "medium");
+        writer.Key("signal").String("medium");
     } else if (csq >= 25 && csq <= 31) {
-        cJSON_AddStringToObject(network, "signal", "strong");
+        writer.Key("signal").String("strong");
     }
-    cJSON_AddItemToObject(root, "network", network);
+    writer.EndObject();
 
-    auto json_str = cJSON_PrintUnformatted(root);
-    std::string json(json_str);
-    cJSON_free(json_str);
-    cJSON_Delete(root);
+    writer.EndObject();
     return json;
 }
@@ -89,6 +89,7 @@ void SleepTimer::CheckTimer() {
                 while (in_light_sleep_mode_) {
                     auto& board = Board::GetInstance();
                     board.GetDisplay()->UpdateStatusBar(true);
+                    board.GetDisplay()->UpdateClock();
                     lv_refr_now(nullptr);
                     lvgl_port_stop();
     
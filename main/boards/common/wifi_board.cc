@@ -5,6 +5,7 @@
 #include "system_info.h"
 #include "settings.h"
 #include "assets/lang_config.h"
+#include "json_writer.h"
 
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
@@ -142,17 +143,19 @@ const char* WifiBoard::GetNetworkStateIcon() {
 std::string WifiBoard::GetBoardJson() {
     // Set the board type for OTA
     auto& wifi_station = WifiStation::GetInstance();
-    std::string board_json = R"({)";
-    board_json += R"("type":")" + std::string(BOARD_TYPE) + R"(",)";
-    board_json += R"("name":")" + std::string(BOARD_NAME) + R"(",)";
+    std::string board_json;
+    JsonWriter writer(board_json, 192);
+    writer.BeginObject();
+    writer.Key("type").String(BOARD_TYPE);
+    writer.Key("name").String(BOARD_NAME);
     if (!wifi_config_mode_) {
-        board_json += R"("ssid":")" + wifi_station.GetSsid() + R"(",)";
-        board_json += R"("rssi":)" + std::to_string(wifi_station.GetRssi()) + R"(,)";
-        board_json += R"("channel":)" + std::to_string(wifi_station.GetChannel()) + R"(,)";
-        board_json += R"("ip":")" + wifi_station.GetIpAddress() + R"(",)";
+        writer.Key("ssid").String(wifi_station.GetSsid());
+        writer.Key("rssi").Int(wifi_station.GetRssi());
+        writer.Key("channel").Int(wifi_station.GetChannel());
+        writer.Key("ip").String(wifi_station.GetIpAddress());
     }
-    board_json += R"("mac":")" + SystemInfo::GetMacAddress() + R"(")";
-    board_json += R"(})";
+    writer.Key("mac").String(SystemInfo::GetMacAddress());
+    writer.EndObject();
     return board_json;
 }
 
@@ -201,68 +204,67 @@ std::string WifiBoard::GetDeviceStatusJson() {
      * }
      */
     auto& board = Board::GetInstance();
-    auto root = cJSON_CreateObject();
+    std::string json;
+    JsonWriter writer(json, 256);
+    writer.BeginObject();
 
     // Audio speaker
-    auto audio_speaker = cJSON_CreateObject();
+    writer.Key("audio_speaker").BeginObject();
     auto audio_codec = board.GetAudioCodec();
     if (audio_codec) {
-        cJSON_AddNumberToObject(audio_speaker, "volume", audio_codec->output_volume());
+        writer.Key("volume").Int(audio_codec->output_volume());
     }
-    cJSON_AddItemToObject(root, "audio_speaker", audio_speaker);
+    writer.EndObject();
 
     // Screen brightness
+    writer.Key("screen").BeginObject();
     auto backlight = board.GetBacklight();
-    auto screen = cJSON_CreateObject();
     if (backlight) {
-        cJSON_AddNumberToObject(screen, "brightness", backlight->brightness());
+        writer.Key("brightness").Int(backlight->brightness());
     }
     auto display = board.GetDisplay();
     if (display && display->height() > 64) { // For LCD display only
         auto theme = display->GetTheme();
         if (theme != nullptr) {
-            cJSON_AddStringToObject(screen, "theme", theme->name().c_str());
+            writer.Key("theme").String(theme->name());
         }
     }
-    cJSON_AddItemToObject(root, "screen", screen);
+    writer.EndObject();
 
     // Battery
     int battery_level = 0;
     bool charging = false;
     bool discharging = false;
     if (board.GetBatteryLevel(battery_level, charging, discharging)) {
-        cJSON* battery = cJSON_CreateObject();
-        cJSON_AddNumberToObject(battery, "level", battery_level);
-        cJSON_AddBoolToObject(battery, "charging", charging);
-        cJSON_AddItemToObject(root, "battery", battery);
+        writer.Key("battery").BeginObject();
+        writer.Key("level").Int(battery_level);
+        writer.Key("charging").Bool(charging);
+        writer.EndObject();
     }
 
     // Network
-    auto network = cJSON_CreateObject();
     auto& wifi_station = WifiStation::GetInstance();
-    cJSON_AddStringToObject(network, "type", "wifi");
-    cJSON_AddStringToObject(network, "ssid", wifi_station.GetSsid().c_str());
+    writer.Key("network").BeginObject();
+    writer.Key("type").String("wifi");
+    writer.Key("ssid").String(wifi_station.GetSsid());
     int rssi = wifi_station.GetRssi();
     if (rssi >= -60) {
-        cJSON_AddStringToObject(network, "signal", "strong");
+        writer.Key("signal").String("strong");
     } else if (rssi >= -70) {
-        cJSON_AddStringToObject(network, "signal", "medium");
+        writer.Key("signal").String("medium");
     } else {
-        cJSON_AddStringToObject(network, "signal", "weak");
+        writer.Key("signal").String("weak");
     }
-    cJSON_AddItemToObject(root, "network", network);
+    writer.EndObject();
 
     // Chip
     float esp32temp = 0.0f;
     if (board.GetTemperature(esp32temp)) {
-        auto chip = cJSON_CreateObject();
-        cJSON_AddNumberToObject(chip, "temperature", esp32temp);
-        cJSON_AddItemToObject(root, "chip", chip);
+        writer.Key("chip").BeginObject();
+        writer.Key("temperature").Number(esp32temp);
+        writer.EndObject();
     }
 
-    auto json_str = cJSON_PrintUnformatted(root);
-    std::string json(json_str);
-    cJSON_free(json_str);
-    cJSON_Delete(root);
+    writer.EndObject();
     return json;
 }
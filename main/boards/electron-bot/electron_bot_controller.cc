@@ -14,6 +14,7 @@
 #include "movements.h"
 #include "sdkconfig.h"
 #include "settings.h"
+#include "json_writer.h"
 
 #define TAG "ElectronBotController"
 
@@ -328,13 +329,16 @@ public:
                                int body = settings.GetInt("body", 0);
                                int head = settings.GetInt("head", 0);
 
-                               std::string result =
-                                   "{\"right_pitch\":" + std::to_string(right_pitch) +
-                                   ",\"right_roll\":" + std::to_string(right_roll) +
-                                   ",\"left_pitch\":" + std::to_string(left_pitch) +
-                                   ",\"left_roll\":" + std::to_string(left_roll) +
-                                   ",\"body\":" + std::to_string(body) +
-                                   ",\"head\":" + std::to_string(head) + "}";
+                               std::string result;
+                               JsonWriter writer(result, 128);
+                               writer.BeginObject();
+                               writer.Key("right_pitch").Int(right_pitch);
+                               writer.Key("right_roll").Int(right_roll);
+                               writer.Key("left_pitch").Int(left_pitch);
+                               writer.Key("left_roll").Int(left_roll);
+                               writer.Key("body").Int(body);
+                               writer.Key("head").Int(head);
+                               writer.EndObject();
 
                                ESP_LOGI(TAG, "获取微调设置: %s", result.c_str());
                                return result;
@@ -348,9 +352,9 @@ public:
                                bool discharging = false;
                                board.GetBatteryLevel(level, charging, discharging);
 
-                               std::string status =
-                                   "{\"level\":" + std::to_string(level) +
-                                   ",\"charging\":" + (charging ? "true" : "false") + "}";
+                               std::string status;
+                               JsonWriter writer(status, 32);
+                               writer.BeginObject().Key("level").Int(level).Key("charging").Bool(charging).EndObject();
                                return status;
                            });
 
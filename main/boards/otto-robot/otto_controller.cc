@@ -15,6 +15,7 @@
 #include "otto_movements.h"
 #include "sdkconfig.h"
 #include "settings.h"
+#include "json_writer.h"
 
 #define TAG "OttoController"
 
@@ -788,13 +789,16 @@ public:
                                int left_hand = settings.GetInt("left_hand", 0);
                                int right_hand = settings.GetInt("right_hand", 0);
 
-                               std::string result =
-                                   "{\"left_leg\":" + std::to_string(left_leg) +
-                                   ",\"right_leg\":" + std::to_string(right_leg) +
-                                   ",\"left_foot\":" + std::to_string(left_foot) +
-                                   ",\"right_foot\":" + std::to_string(right_foot) +
-                                   ",\"left_hand\":" + std::to_string(left_hand) +
-                                   ",\"right_hand\":" + std::to_string(right_hand) + "}";
+                               std::string result;
+                               JsonWriter writer(result, 128);
+                               writer.BeginObject();
+                               writer.Key("left_leg").Int(left_leg);
+                               writer.Key("right_leg").Int(right_leg);
+                               writer.Key("left_foot").Int(left_foot);
+                               writer.Key("right_foot").Int(right_foot);
+                               writer.Key("left_hand").Int(left_hand);
+                               writer.Key("right_hand").Int(right_hand);
+                               writer.EndObject();
 
                                ESP_LOGI(TAG, "获取微调设置: %s", result.c_str());
                                return result;
@@ -813,9 +817,9 @@ public:
                                bool discharging = false;
                                board.GetBatteryLevel(level, charging, discharging);
 
-                               std::string status =
-                                   "{\"level\":" + std::to_string(level) +
-                                   ",\"charging\":" + (charging ? "true" : "false") + "}";
+                               std::string status;
+                               JsonWriter writer(status, 32);
+                               writer.BeginObject().Key("level").Int(level).Key("charging").Bool(charging).EndObject();
                                return status;
                            });
 
@@ -6,6 +6,7 @@
 #include "system_info.h"
 #include "config.h"
 #include "settings.h"
+#include "tagged_heap.h"
 
 #include <esp_log.h>
 #include <esp_heap_caps.h>
@@ -585,13 +586,14 @@ bool SscmaCamera::Capture() {
         size_t image_size = w * h * 2;
         size_t stride = preview_image_.header.w * 2;
 
-        uint8_t* data = (uint8_t*)heap_caps_malloc(image_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        uint8_t* data = (uint8_t*)TaggedHeap::Malloc(kHeapTagCamera, image_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
         if (data == nullptr) {
             ESP_LOGE(TAG, "Failed to allocate memory for display image");
             return true;
         }
         memcpy(data, preview_image_.data, image_size);
         
+        TaggedHeap::Transfer(kHeapTagCamera, kHeapTagDisplay, data);
         auto image = std::make_unique<LvglAllocatedImage>(data, image_size, w, h, stride, LV_COLOR_FORMAT_RGB565);
         display->SetPreviewImage(std::move(image));
     }
@@ -0,0 +1,111 @@
+#include "chat_history.h"
+#include "tagged_heap.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <cstring>
+#include <string>
+
+#define TAG "ChatHistory"
+
+ChatHistory::ChatHistory(size_t capacity) : capacity_(capacity) {
+#if CONFIG_SPIRAM
+    buffer_ = (char*)TaggedHeap::Malloc(kHeapTagDisplay, capacity_, MALLOC_CAP_SPIRAM);
+#endif
+    if (buffer_ == nullptr) {
+        buffer_ = (char*)TaggedHeap::Malloc(kHeapTagDisplay, capacity_, MALLOC_CAP_8BIT);
+    }
+    if (buffer_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate %u bytes", capacity_);
+        capacity_ = 0;
+    }
+}
+
+ChatHistory::~ChatHistory() {
+    if (buffer_ != nullptr) {
+        TaggedHeap::Free(kHeapTagDisplay, buffer_);
+    }
+}
+
+uint32_t ChatHistory::Append(ChatRole role, const char* text) {
+    size_t length = strlen(text);
+    if (length + 1 > capacity_) {
+        length = capacity_ > 0 ? capacity_ - 1 : 0;
+    }
+    if (length > UINT16_MAX) {
+        length = UINT16_MAX;
+    }
+    size_t size = length + 1;
+    if (capacity_ == 0) {
+        entries_.push_back({0, 0, role});
+        return end_id() - 1;
+    }
+
+    if (write_offset_ + size > capacity_) {
+        // Wrap around, the entries left at the tail are the oldest ones
+        while (!entries_.empty() && entries_.front().offset >= write_offset_) {
+            entries_.pop_front();
+            first_id_++;
+        }
+        write_offset_ = 0;
+    }
+    // Drop the entries of the previous lap that the new text overwrites
+    while (!entries_.empty() && entries_.front().offset >= write_offset_ &&
+           entries_.front().offset < write_offset_ + size) {
+        entries_.pop_front();
+        first_id_++;
+    }
+
+    memcpy(buffer_ + write_offset_, text, length);
+    buffer_[write_offset_ + length] = '\0';
+    entries_.push_back({(uint32_t)write_offset_, (uint16_t)length, role});
+    write_offset_ += size;
+    return end_id() - 1;
+}
+
+void ChatHistory::Extend(const char* text) {
+    if (entries_.empty() || capacity_ == 0) {
+        return;
+    }
+    auto& last = entries_.back();
+    size_t length = strlen(text);
+    size_t end_offset = last.offset + last.length;
+    if (write_offset_ == end_offset + 1 && end_offset + length + 1 <= capacity_ && last.length + length <= UINT16_MAX) {
+        // Overwrite the terminator, dropping the entries of the previous lap in the way
+        while (entries_.size() > 1 && entries_.front().offset > end_offset &&
+               entries_.front().offset <= end_offset + length) {
+            entries_.pop_front();
+            first_id_++;
+        }
+        memcpy(buffer_ + end_offset, text, length);
+        buffer_[end_offset + length] = '\0';
+        entries_.back().length += length;
+        write_offset_ = end_offset + length + 1;
+        return;
+    }
+
+    // No room behind the message, move it to a new place in the ring
+    ChatRole role = last.role;
+    std::string combined(buffer_ + last.offset, last.length);
+    combined += text;
+    RemoveLast();
+    Append(role, combined.c_str());
+}
+
+void ChatHistory::RemoveLast() {
+    if (entries_.empty()) {
+        return;
+    }
+    write_offset_ = entries_.back().offset;
+    entries_.pop_back();
+}
+
+bool ChatHistory::Get(uint32_t id, ChatRole& role, const char*& text) const {
+    if (id < first_id_ || id >= end_id()) {
+        return false;
+    }
+    auto& entry = entries_[id - first_id_];
+    role = entry.role;
+    text = capacity_ > 0 ? buffer_ + entry.offset : "";
+    return true;
+}
@@ -0,0 +1,49 @@
+#ifndef CHAT_HISTORY_H
+#define CHAT_HISTORY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+
+enum ChatRole : uint8_t {
+    kChatRoleUser,
+    kChatRoleAssistant,
+    kChatRoleSystem,
+};
+
+/*
+ * Chat messages kept as text in a fixed size byte ring, so the display only needs
+ * widgets for the messages on screen. Each message gets an increasing id, the oldest
+ * messages are dropped when the ring is full.
+ */
+class ChatHistory {
+public:
+    ChatHistory(size_t capacity);
+    ~ChatHistory();
+
+    uint32_t Append(ChatRole role, const char* text);
+    // Append text to the last message, in place when the ring has room behind it
+    void Extend(const char* text);
+    void RemoveLast();
+    // The text is only valid until the next Append
+    bool Get(uint32_t id, ChatRole& role, const char*& text) const;
+
+    uint32_t first_id() const { return first_id_; }
+    uint32_t end_id() const { return first_id_ + entries_.size(); }
+    bool empty() const { return entries_.empty(); }
+
+private:
+    struct Entry {
+        uint32_t offset;
+        uint16_t length;
+        ChatRole role;
+    };
+
+    char* buffer_ = nullptr;
+    size_t capacity_ = 0;
+    size_t write_offset_ = 0;
+    uint32_t first_id_ = 0;
+    std::deque<Entry> entries_;
+};
+
+#endif // CHAT_HISTORY_H
@@ -35,6 +35,15 @@ void Display::ShowNotification(const char* notification, int duration_ms) {
 void Display::UpdateStatusBar(bool update_all) {
 }
 
+void Display::SetMuted(bool muted) {
+}
+
+void Display::UpdateClock() {
+}
+
+void Display::PrintRenderStatistics() {
+}
+
 
 void Display::SetEmotion(const char* emotion) {
     ESP_LOGW(TAG, "SetEmotion: %s", emotion);
@@ -45,6 +54,11 @@ void Display::SetChatMessage(const char* role, const char* content) {
     ESP_LOGW(TAG, "     %s", content);
 }
 
+void Display::AppendChatText(const char* role, const char* delta) {
+    // Displays that only show the latest sentence simply replace it
+    SetChatMessage(role, delta);
+}
+
 void Display::SetTheme(Theme* theme) {
     current_theme_ = theme;
     Settings settings("display", true);
@@ -35,9 +35,15 @@ public:
     virtual void ShowNotification(const std::string &notification, int duration_ms = 3000);
     virtual void SetEmotion(const char* emotion);
     virtual void SetChatMessage(const char* role, const char* content);
+    // Extend the latest message of the role with more text, e.g. the next sentence of an answer
+    virtual void AppendChatText(const char* role, const char* delta);
     virtual void SetTheme(Theme* theme);
     virtual Theme* GetTheme() { return current_theme_; }
     virtual void UpdateStatusBar(bool update_all = false);
+    // Published by the codec whenever the output volume changes
+    virtual void SetMuted(bool muted);
+    virtual void UpdateClock();
+    virtual void PrintRenderStatistics();
     virtual void SetPowerSaveMode(bool on);
 
     inline int width() const { return width_; }
@@ -470,6 +470,13 @@ void EmoteDisplay::ShowNotification(const char* notification, int duration_ms)
 }
 
 void EmoteDisplay::UpdateStatusBar(bool update_all)
+{
+    if (update_all) {
+        UpdateClock();
+    }
+}
+
+void EmoteDisplay::UpdateClock()
 {
     if (!engine_) {
         return;
@@ -1,5 +1,4 @@
 #include "lcd_display.h"
-#include "gif/lvgl_gif.h"
 #include "settings.h"
 #include "lvgl_theme.h"
 #include "assets/lang_config.h"
@@ -11,9 +10,12 @@
 #include <esp_err.h>
 #include <esp_lvgl_port.h>
 #include <esp_psram.h>
+#include <esp_heap_caps.h>
 #include <cstring>
+#include <cctype>
 
 #include "board.h"
+#include "application.h"
 
 #define TAG "LcdDisplay"
 
@@ -89,7 +91,8 @@ LcdDisplay::LcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handle_
 }
 
 SpiLcdDisplay::SpiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handle_t panel,
-                           int width, int height, int offset_x, int offset_y, bool mirror_x, bool mirror_y, bool swap_xy)
+                           int width, int height, int offset_x, int offset_y, bool mirror_x, bool mirror_y, bool swap_xy,
+                           const LcdRenderConfig& render_config)
     : LcdDisplay(panel_io, panel, width, height) {
 
     // draw white
@@ -132,14 +135,38 @@ SpiLcdDisplay::SpiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_h
 #endif
     lvgl_port_init(&port_cfg);
 
-    ESP_LOGI(TAG, "Adding LCD display");
+    // Full frame buffers live in PSRAM, which SPI DMA can not read, so esp_lvgl_port copies
+    // them to the panel through a bounce buffer of trans_size pixels in internal SRAM
+    bool full_frame_psram = render_config.full_frame_psram;
+#if !CONFIG_SPIRAM
+    full_frame_psram = false;
+#endif
+    int buffer_lines = std::clamp(render_config.buffer_lines, 1, height_);
+    int bounce_lines = std::clamp(render_config.bounce_lines, 1, height_);
+    if (!full_frame_psram) {
+        // The draw buffers share internal DMA memory with Wi-Fi, TLS and audio, they get at most a quarter of it
+        size_t line_size = width_ * sizeof(uint16_t);
+        size_t buffer_count = render_config.double_buffer ? 2 : 1;
+        size_t budget = std::min(heap_caps_get_free_size(MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL) / 4 / buffer_count,
+            heap_caps_get_largest_free_block(MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL));
+        int max_lines = std::max<int>(budget / line_size, 1);
+        if (buffer_lines > max_lines) {
+            ESP_LOGW(TAG, "Draw buffer lines %d limited to %d by free DMA memory", buffer_lines, max_lines);
+            buffer_lines = max_lines;
+        }
+    }
+    uint32_t buffer_size = width_ * (full_frame_psram ? height_ : buffer_lines);
+    uint32_t trans_size = full_frame_psram ? width_ * bounce_lines : 0;
+    ESP_LOGI(TAG, "Adding LCD display, %s buffer of %lu pixels%s, bounce buffer of %lu pixels",
+        render_config.double_buffer ? "double" : "single", buffer_size,
+        full_frame_psram ? " in PSRAM" : "", trans_size);
     const lvgl_port_display_cfg_t display_cfg = {
         .io_handle = panel_io_,
         .panel_handle = panel_,
         .control_handle = nullptr,
-        .buffer_size = static_cast<uint32_t>(width_ * 20),
-        .double_buffer = false,
-        .trans_size = 0,
+        .buffer_size = buffer_size,
+        .double_buffer = render_config.double_buffer,
+        .trans_size = trans_size,
         .hres = static_cast<uint32_t>(width_),
         .vres = static_cast<uint32_t>(height_),
         .monochrome = false,
@@ -150,8 +177,8 @@ SpiLcdDisplay::SpiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_h
         },
         .color_format = LV_COLOR_FORMAT_RGB565,
         .flags = {
-            .buff_dma = 1,
-            .buff_spiram = 0,
+            .buff_dma = !full_frame_psram,
+            .buff_spiram = full_frame_psram,
             .sw_rotate = 0,
             .swap_bytes = 1,
             .full_refresh = 0,
@@ -164,6 +191,7 @@ SpiLcdDisplay::SpiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_h
         ESP_LOGE(TAG, "Failed to add display");
         return;
     }
+    AddRenderEvents();
 
     if (offset_x != 0 || offset_y != 0) {
         lv_display_set_offset(display_, offset_x, offset_y);
@@ -227,6 +255,7 @@ RgbLcdDisplay::RgbLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_h
         ESP_LOGE(TAG, "Failed to add RGB display");
         return;
     }
+    AddRenderEvents();
     
     if (offset_x != 0 || offset_y != 0) {
         lv_display_set_offset(display_, offset_x, offset_y);
@@ -280,6 +309,7 @@ MipiLcdDisplay::MipiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel
         ESP_LOGE(TAG, "Failed to add display");
         return;
     }
+    AddRenderEvents();
 
     if (offset_x != 0 || offset_y != 0) {
         lv_display_set_offset(display_, offset_x, offset_y);
@@ -294,8 +324,12 @@ LcdDisplay::~LcdDisplay() {
     // Clean up GIF controller
     if (gif_controller_) {
         gif_controller_->Stop();
-        gif_controller_.reset();
+        gif_controller_ = nullptr;
     }
+    if (gif_prewarm_timer_ != nullptr) {
+        lv_timer_delete(gif_prewarm_timer_);
+    }
+    gif_cache_.Clear();
     
     if (preview_timer_ != nullptr) {
         esp_timer_stop(preview_timer_);
@@ -350,6 +384,22 @@ void LcdDisplay::Unlock() {
 }
 
 #if CONFIG_USE_WECHAT_MESSAGE_STYLE
+// Message rows kept as widgets, older messages only live in the chat history
+#if CONFIG_IDF_TARGET_ESP32P4
+#define MAX_CHAT_ROWS 20
+#else
+#define MAX_CHAT_ROWS 10
+#endif
+
+#if CONFIG_SPIRAM
+#define CHAT_HISTORY_SIZE (16 * 1024)
+#else
+#define CHAT_HISTORY_SIZE 2048
+#endif
+
+// Appended text goes into a new label once the last one is this long, so only the new lines are wrapped again
+#define CHAT_SEGMENT_SIZE 256
+
 void LcdDisplay::SetupUI() {
     DisplayLockGuard lock(this);
 
@@ -401,6 +451,10 @@ void LcdDisplay::SetupUI() {
 
     // We'll create chat messages dynamically in SetChatMessage
     chat_message_label_ = nullptr;
+    chat_history_ = std::make_unique<ChatHistory>(CHAT_HISTORY_SIZE);
+    lv_obj_add_event_cb(content_, [](lv_event_t* e) {
+        static_cast<LcdDisplay*>(lv_event_get_user_data(e))->OnChatScrollEnd();
+    }, LV_EVENT_SCROLL_END, this);
 
     /* Status bar */
     lv_obj_set_flex_flow(status_bar_, LV_FLEX_FLOW_ROW);
@@ -467,48 +521,210 @@ void LcdDisplay::SetupUI() {
     lv_obj_set_style_text_color(emoji_label_, lvgl_theme->text_color(), 0);
     lv_label_set_text(emoji_label_, FONT_AWESOME_MICROCHIP_AI);
 }
-#if CONFIG_IDF_TARGET_ESP32P4
-#define  MAX_MESSAGES 40
-#else
-#define  MAX_MESSAGES 20
-#endif
+
+static const char* const kChatRoleNames[] = {"user", "assistant", "system"};
+
+static ChatRole ParseChatRole(const char* role) {
+    if (strcmp(role, "user") == 0) {
+        return kChatRoleUser;
+    } else if (strcmp(role, "system") == 0) {
+        return kChatRoleSystem;
+    }
+    return kChatRoleAssistant;
+}
+
+lv_obj_t* LcdDisplay::CreateChatRow() {
+    auto lvgl_theme = static_cast<LvglTheme*>(current_theme_);
+
+    // A transparent full width row, so the bubble can be aligned left, right or centered in it
+    lv_obj_t* row = lv_obj_create(content_);
+    lv_obj_set_width(row, LV_HOR_RES);
+    lv_obj_set_height(row, LV_SIZE_CONTENT);
+    lv_obj_set_style_bg_opa(row, LV_OPA_TRANSP, 0);
+    lv_obj_set_style_border_width(row, 0, 0);
+    lv_obj_set_style_pad_all(row, 0, 0);
+
+    lv_obj_t* bubble = lv_obj_create(row);
+    lv_obj_set_style_radius(bubble, 8, 0);
+    lv_obj_set_scrollbar_mode(bubble, LV_SCROLLBAR_MODE_OFF);
+    lv_obj_set_style_border_width(bubble, 0, 0);
+    lv_obj_set_style_pad_all(bubble, lvgl_theme->spacing(4), 0);
+    lv_obj_set_style_bg_opa(bubble, LV_OPA_70, 0);
+    lv_obj_set_size(bubble, LV_SIZE_CONTENT, LV_SIZE_CONTENT);
+    lv_obj_set_style_flex_grow(bubble, 0, 0);
+    // Long streamed messages are split into several labels stacked in the bubble
+    lv_obj_set_flex_flow(bubble, LV_FLEX_FLOW_COLUMN);
+    lv_obj_set_style_pad_row(bubble, 0, 0);
+
+    lv_obj_t* text = lv_label_create(bubble);
+    lv_label_set_long_mode(text, LV_LABEL_LONG_WRAP);
+
+    chat_row_count_++;
+    return row;
+}
+
+lv_obj_t* LcdDisplay::AcquireChatRow() {
+    if (!spare_chat_rows_.empty()) {
+        lv_obj_t* row = spare_chat_rows_.back();
+        spare_chat_rows_.pop_back();
+        return row;
+    }
+    if (chat_row_count_ < MAX_CHAT_ROWS) {
+        return CreateChatRow();
+    }
+    return nullptr;
+}
+
+void LcdDisplay::ReleaseChatRow(lv_obj_t* row) {
+    lv_obj_add_flag(row, LV_OBJ_FLAG_HIDDEN);
+    spare_chat_rows_.push_back(row);
+}
+
+void LcdDisplay::BindChatRow(lv_obj_t* row, uint32_t id) {
+    ChatRole role = kChatRoleSystem;
+    const char* content = "";
+    chat_history_->Get(id, role, content);
+
+    auto lvgl_theme = static_cast<LvglTheme*>(current_theme_);
+    lv_obj_t* bubble = lv_obj_get_child(row, 0);
+    // Drop the extra labels of a streamed message
+    while (lv_obj_get_child_cnt(bubble) > 1) {
+        lv_obj_del(lv_obj_get_child(bubble, -1));
+    }
+    lv_obj_t* text = lv_obj_get_child(bubble, 0);
+    lv_label_set_text(text, content);
+    SetChatTextWidth(text);
+
+    // 设置自定义属性标记气泡类型
+    lv_obj_set_user_data(bubble, (void*)kChatRoleNames[role]);
+    if (role == kChatRoleUser) {
+        // User messages are right-aligned with green background
+        lv_obj_set_style_bg_color(bubble, lvgl_theme->user_bubble_color(), 0);
+        lv_obj_set_style_text_color(text, lvgl_theme->text_color(), 0);
+        lv_obj_align(bubble, LV_ALIGN_RIGHT_MID, -25, 0);
+    } else if (role == kChatRoleSystem) {
+        // System messages are center-aligned with light gray background
+        lv_obj_set_style_bg_color(bubble, lvgl_theme->system_bubble_color(), 0);
+        lv_obj_set_style_text_color(text, lvgl_theme->system_text_color(), 0);
+        lv_obj_align(bubble, LV_ALIGN_CENTER, 0, 0);
+    } else {
+        // Assistant messages are left-aligned with white background
+        lv_obj_set_style_bg_color(bubble, lvgl_theme->assistant_bubble_color(), 0);
+        lv_obj_set_style_text_color(text, lvgl_theme->text_color(), 0);
+        lv_obj_align(bubble, LV_ALIGN_LEFT_MID, 0, 0);
+    }
+    lv_obj_remove_flag(row, LV_OBJ_FLAG_HIDDEN);
+}
+
+void LcdDisplay::SetChatTextWidth(lv_obj_t* text) {
+    // 计算文本实际宽度，限制在 20 像素到屏幕宽度的 85% 之间
+    auto text_font = static_cast<LvglTheme*>(current_theme_)->text_font()->font();
+    const char* content = lv_label_get_text(text);
+    lv_coord_t text_width = lv_txt_get_width(content, strlen(content), text_font, 0);
+    lv_coord_t max_width = LV_HOR_RES * 85 / 100 - 16;
+    lv_coord_t min_width = 20;
+    lv_obj_set_width(text, std::clamp(text_width, min_width, max_width));
+}
+
+void LcdDisplay::PlaceChatImage() {
+    if (chat_image_ == nullptr) {
+        return;
+    }
+    // Image previews are not kept in the history, the preview goes away with the message it followed
+    if (chat_image_next_id_ < chat_history_->first_id()) {
+        lv_obj_del(chat_image_);
+        chat_image_ = nullptr;
+        return;
+    }
+    uint32_t window_end = chat_window_first_ + chat_rows_.size();
+    bool visible = chat_image_next_id_ <= window_end && (chat_image_next_id_ > chat_window_first_ ||
+        chat_window_first_ == chat_history_->first_id());
+    if (!visible) {
+        lv_obj_add_flag(chat_image_, LV_OBJ_FLAG_HIDDEN);
+        return;
+    }
+    lv_obj_remove_flag(chat_image_, LV_OBJ_FLAG_HIDDEN);
+    if (chat_image_next_id_ == window_end) {
+        lv_obj_move_foreground(chat_image_);
+        return;
+    }
+    // Moving to a later index shifts the row up by one, so the target is the row index minus one
+    int32_t row_index = lv_obj_get_index(chat_rows_[chat_image_next_id_ - chat_window_first_]);
+    int32_t image_index = lv_obj_get_index(chat_image_);
+    lv_obj_move_to_index(chat_image_, image_index < row_index ? row_index - 1 : row_index);
+}
+
+void LcdDisplay::ShowLatestChatMessages() {
+    uint32_t end = chat_history_->end_id();
+    uint32_t first = std::max<uint32_t>(chat_history_->first_id(), end - std::min<uint32_t>(end, chat_rows_.size()));
+    while (chat_rows_.size() > end - first) {
+        ReleaseChatRow(chat_rows_.back());
+        chat_rows_.pop_back();
+    }
+    chat_window_first_ = first;
+    for (size_t i = 0; i < chat_rows_.size(); i++) {
+        lv_obj_move_foreground(chat_rows_[i]);
+        BindChatRow(chat_rows_[i], first + i);
+    }
+    PlaceChatImage();
+    lv_obj_scroll_to_y(content_, LV_COORD_MAX, LV_ANIM_OFF);
+}
+
+void LcdDisplay::OnChatScrollEnd() {
+    if (chat_history_ == nullptr) {
+        return;
+    }
+    uint32_t window_end = chat_window_first_ + chat_rows_.size();
+    if (lv_obj_get_scroll_top(content_) <= 0 && chat_window_first_ > chat_history_->first_id()) {
+        // Reached the top, bring back the previous message from the history
+        lv_obj_t* row = AcquireChatRow();
+        if (row == nullptr) {
+            row = chat_rows_.back();
+            chat_rows_.pop_back();
+        }
+        chat_window_first_--;
+        lv_obj_move_background(row);
+        BindChatRow(row, chat_window_first_);
+        chat_rows_.push_front(row);
+        PlaceChatImage();
+    } else if (lv_obj_get_scroll_bottom(content_) <= 0 && window_end < chat_history_->end_id() && !chat_rows_.empty()) {
+        // Reached the bottom while browsing the history, recycle the top row for the next message
+        lv_obj_t* row = chat_rows_.front();
+        lv_coord_t removed_height = lv_obj_get_height(row) + lv_obj_get_style_pad_row(content_, 0);
+        chat_rows_.pop_front();
+        chat_window_first_++;
+        lv_obj_move_foreground(row);
+        BindChatRow(row, window_end);
+        chat_rows_.push_back(row);
+        PlaceChatImage();
+        // Keep the messages on screen where they were
+        lv_obj_update_layout(content_);
+        lv_obj_scroll_by(content_, 0, removed_height, LV_ANIM_OFF);
+    }
+}
+
 void LcdDisplay::SetChatMessage(const char* role, const char* content) {
     DisplayLockGuard lock(this);
-    if (content_ == nullptr) {
+    if (content_ == nullptr || chat_history_ == nullptr) {
         return;
     }
-    
-    // 检查消息数量是否超过限制
-    uint32_t child_count = lv_obj_get_child_cnt(content_);
-    if (child_count >= MAX_MESSAGES) {
-        // 删除最早的消息（第一个子对象）
-        lv_obj_t* first_child = lv_obj_get_child(content_, 0);
-        lv_obj_t* last_child = lv_obj_get_child(content_, child_count - 1);
-        if (first_child != nullptr) {
-            lv_obj_del(first_child);
-        }
-        // Scroll to the last message immediately
-        if (last_child != nullptr) {
-            lv_obj_scroll_to_view_recursive(last_child, LV_ANIM_OFF);
-        }
+    int64_t start_time = esp_timer_get_time();
+
+    // New messages always show up at the end, leave the history if it is being browsed
+    if (chat_window_first_ + chat_rows_.size() != chat_history_->end_id()) {
+        ShowLatestChatMessages();
     }
-    
-    // 折叠系统消息（如果是系统消息，检查最后一个消息是否也是系统消息）
-    if (strcmp(role, "system") == 0) {
-        if (child_count > 0) {
-            // 获取最后一个消息容器
-            lv_obj_t* last_container = lv_obj_get_child(content_, child_count - 1);
-            if (last_container != nullptr && lv_obj_get_child_cnt(last_container) > 0) {
-                // 获取容器内的气泡
-                lv_obj_t* last_bubble = lv_obj_get_child(last_container, 0);
-                if (last_bubble != nullptr) {
-                    // 检查气泡类型是否为系统消息
-                    void* bubble_type_ptr = lv_obj_get_user_data(last_bubble);
-                    if (bubble_type_ptr != nullptr && strcmp((const char*)bubble_type_ptr, "system") == 0) {
-                        // 如果最后一个消息也是系统消息，则删除它
-                        lv_obj_del(last_container);
-                    }
-                }
+
+    auto chat_role = ParseChatRole(role);
+    if (chat_role == kChatRoleSystem) {
+        // 折叠系统消息（如果最后一个消息也是系统消息，则替换它）
+        ChatRole last_role;
+        const char* last_content;
+        if (chat_history_->Get(chat_history_->end_id() - 1, last_role, last_content) && last_role == kChatRoleSystem) {
+            chat_history_->RemoveLast();
+            if (!chat_rows_.empty()) {
+                ReleaseChatRow(chat_rows_.back());
+                chat_rows_.pop_back();
             }
         }
     } else {
@@ -517,153 +733,82 @@ void LcdDisplay::SetChatMessage(const char* role, const char* content) {
     }
 
     //避免出现空的消息框
-    if(strlen(content) == 0) {
+    if (strlen(content) == 0) {
         return;
     }
 
-    auto lvgl_theme = static_cast<LvglTheme*>(current_theme_);
-    auto text_font = lvgl_theme->text_font()->font();
+    uint32_t id = chat_history_->Append(chat_role, content);
+    lv_obj_t* row = AcquireChatRow();
+    bool recycled = row == nullptr;
+    if (recycled) {
+        // All rows are in use, recycle the oldest one instead of creating a new object
+        row = chat_rows_.front();
+        chat_rows_.pop_front();
+    }
+    lv_obj_move_foreground(row);
+    BindChatRow(row, id);
+    chat_rows_.push_back(row);
+    chat_window_first_ = chat_history_->end_id() - chat_rows_.size();
+    PlaceChatImage();
+    // Store reference to the latest message label
+    chat_message_label_ = lv_obj_get_child(lv_obj_get_child(row, 0), 0);
 
-    // Create a message bubble
-    lv_obj_t* msg_bubble = lv_obj_create(content_);
-    lv_obj_set_style_radius(msg_bubble, 8, 0);
-    lv_obj_set_scrollbar_mode(msg_bubble, LV_SCROLLBAR_MODE_OFF);
-    lv_obj_set_style_border_width(msg_bubble, 0, 0);
-    lv_obj_set_style_pad_all(msg_bubble, lvgl_theme->spacing(4), 0);
+    // Auto-scroll to the new message, jump without animation when the list has been trimmed
+    lv_obj_scroll_to_view_recursive(row, recycled ? LV_ANIM_OFF : LV_ANIM_ON);
+    ESP_LOGD(TAG, "Chat message %lu appended in %lld us, %u rows", id, esp_timer_get_time() - start_time, chat_row_count_);
+}
 
-    // Create the message text
-    lv_obj_t* msg_text = lv_label_create(msg_bubble);
-    lv_label_set_text(msg_text, content);
-    
-    // 计算文本实际宽度
-    lv_coord_t text_width = lv_txt_get_width(content, strlen(content), text_font, 0);
+void LcdDisplay::AppendChatText(const char* role, const char* delta) {
+    DisplayLockGuard lock(this);
+    if (content_ == nullptr || chat_history_ == nullptr || delta[0] == '\0') {
+        return;
+    }
+    int64_t start_time = esp_timer_get_time();
 
-    // 计算气泡宽度
-    lv_coord_t max_width = LV_HOR_RES * 85 / 100 - 16;  // 屏幕宽度的85%
-    lv_coord_t min_width = 20;  
-    lv_coord_t bubble_width;
-    
-    // 确保文本宽度不小于最小宽度
-    if (text_width < min_width) {
-        text_width = min_width;
+    if (chat_window_first_ + chat_rows_.size() != chat_history_->end_id()) {
+        ShowLatestChatMessages();
     }
 
-    // 如果文本宽度小于最大宽度，使用文本宽度
-    if (text_width < max_width) {
-        bubble_width = text_width; 
-    } else {
-        bubble_width = max_width;
+    // Start a new message unless the latest one belongs to the same role
+    auto chat_role = ParseChatRole(role);
+    ChatRole last_role;
+    const char* last_content;
+    if (chat_rows_.empty() || !chat_history_->Get(chat_history_->end_id() - 1, last_role, last_content) ||
+        last_role != chat_role) {
+        SetChatMessage(role, delta);
+        return;
     }
-    
-    // 设置消息文本的宽度
-    lv_obj_set_width(msg_text, bubble_width);  // 减去padding
-    lv_label_set_long_mode(msg_text, LV_LABEL_LONG_WRAP);
 
-    // 设置气泡宽度
-    lv_obj_set_width(msg_bubble, bubble_width);
-    lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
+    // Sentences of latin text need a space in between, CJK text does not
+    size_t last_length = strlen(last_content);
+    bool need_space = last_length > 0 && (uint8_t)last_content[last_length - 1] < 0x80 &&
+        !isspace((uint8_t)last_content[last_length - 1]) && (uint8_t)delta[0] < 0x80 && !isspace((uint8_t)delta[0]);
+    if (need_space) {
+        chat_history_->Extend(" ");
+    }
+    chat_history_->Extend(delta);
 
-    // Set alignment and style based on message role
-    if (strcmp(role, "user") == 0) {
-        // User messages are right-aligned with green background
-        lv_obj_set_style_bg_color(msg_bubble, lvgl_theme->user_bubble_color(), 0);
-        lv_obj_set_style_bg_opa(msg_bubble, LV_OPA_70, 0);
-        // Set text color for contrast
-        lv_obj_set_style_text_color(msg_text, lvgl_theme->text_color(), 0);
-        
-        // 设置自定义属性标记气泡类型
-        lv_obj_set_user_data(msg_bubble, (void*)"user");
-        
-        // Set appropriate width for content
-        lv_obj_set_width(msg_bubble, LV_SIZE_CONTENT);
-        lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
-        
-        // Don't grow
-        lv_obj_set_style_flex_grow(msg_bubble, 0, 0);
-    } else if (strcmp(role, "assistant") == 0) {
-        // Assistant messages are left-aligned with white background
-        lv_obj_set_style_bg_color(msg_bubble, lvgl_theme->assistant_bubble_color(), 0);
-        lv_obj_set_style_bg_opa(msg_bubble, LV_OPA_70, 0);
-        // Set text color for contrast
-        lv_obj_set_style_text_color(msg_text, lvgl_theme->text_color(), 0);
-        
-        // 设置自定义属性标记气泡类型
-        lv_obj_set_user_data(msg_bubble, (void*)"assistant");
-        
-        // Set appropriate width for content
-        lv_obj_set_width(msg_bubble, LV_SIZE_CONTENT);
-        lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
-        
-        // Don't grow
-        lv_obj_set_style_flex_grow(msg_bubble, 0, 0);
-    } else if (strcmp(role, "system") == 0) {
-        // System messages are center-aligned with light gray background
-        lv_obj_set_style_bg_color(msg_bubble, lvgl_theme->system_bubble_color(), 0);
-        lv_obj_set_style_bg_opa(msg_bubble, LV_OPA_70, 0);
-        // Set text color for contrast
-        lv_obj_set_style_text_color(msg_text, lvgl_theme->system_text_color(), 0);
-        
-        // 设置自定义属性标记气泡类型
-        lv_obj_set_user_data(msg_bubble, (void*)"system");
-        
-        // Set appropriate width for content
-        lv_obj_set_width(msg_bubble, LV_SIZE_CONTENT);
-        lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
-        
-        // Don't grow
-        lv_obj_set_style_flex_grow(msg_bubble, 0, 0);
+    lv_obj_t* bubble = lv_obj_get_child(chat_rows_.back(), 0);
+    lv_obj_t* text = lv_obj_get_child(bubble, -1);
+    // The labels of a bubble hold exactly the history text, the separator goes at the end of the last one
+    if (need_space) {
+        lv_label_ins_text(text, LV_LABEL_POS_LAST, " ");
     }
-    
-    // Create a full-width container for user messages to ensure right alignment
-    if (strcmp(role, "user") == 0) {
-        // Create a full-width container
-        lv_obj_t* container = lv_obj_create(content_);
-        lv_obj_set_width(container, LV_HOR_RES);
-        lv_obj_set_height(container, LV_SIZE_CONTENT);
-        
-        // Make container transparent and borderless
-        lv_obj_set_style_bg_opa(container, LV_OPA_TRANSP, 0);
-        lv_obj_set_style_border_width(container, 0, 0);
-        lv_obj_set_style_pad_all(container, 0, 0);
-        
-        // Move the message bubble into this container
-        lv_obj_set_parent(msg_bubble, container);
-        
-        // Right align the bubble in the container
-        lv_obj_align(msg_bubble, LV_ALIGN_RIGHT_MID, -25, 0);
-        
-        // Auto-scroll to this container
-        lv_obj_scroll_to_view_recursive(container, LV_ANIM_ON);
-    } else if (strcmp(role, "system") == 0) {
-        // 为系统消息创建全宽容器以确保居中对齐
-        lv_obj_t* container = lv_obj_create(content_);
-        lv_obj_set_width(container, LV_HOR_RES);
-        lv_obj_set_height(container, LV_SIZE_CONTENT);
-        
-        // 使容器透明且无边框
-        lv_obj_set_style_bg_opa(container, LV_OPA_TRANSP, 0);
-        lv_obj_set_style_border_width(container, 0, 0);
-        lv_obj_set_style_pad_all(container, 0, 0);
-        
-        // 将消息气泡移入此容器
-        lv_obj_set_parent(msg_bubble, container);
-        
-        // 将气泡居中对齐在容器中
-        lv_obj_align(msg_bubble, LV_ALIGN_CENTER, 0, 0);
-        
-        // 自动滚动底部
-        lv_obj_scroll_to_view_recursive(container, LV_ANIM_ON);
+    if (strlen(lv_label_get_text(text)) + strlen(delta) > CHAT_SEGMENT_SIZE) {
+        // Continue in a new label, the lines above keep their layout
+        lv_obj_t* segment = lv_label_create(bubble);
+        lv_label_set_long_mode(segment, LV_LABEL_LONG_WRAP);
+        lv_obj_set_style_text_color(segment, lv_obj_get_style_text_color(text, 0), 0);
+        lv_label_set_text(segment, delta);
+        text = segment;
     } else {
-        // For assistant messages
-        // Left align assistant messages
-        lv_obj_align(msg_bubble, LV_ALIGN_LEFT_MID, 0, 0);
-
-        // Auto-scroll to the message bubble
-        lv_obj_scroll_to_view_recursive(msg_bubble, LV_ANIM_ON);
+        lv_label_ins_text(text, LV_LABEL_POS_LAST, delta);
     }
-    
-    // Store reference to the latest message label
-    chat_message_label_ = msg_text;
+    SetChatTextWidth(text);
+    chat_message_label_ = text;
+
+    lv_obj_scroll_to_view_recursive(text, LV_ANIM_ON);
+    ESP_LOGD(TAG, "Chat text appended in %lld us, %u bytes", esp_timer_get_time() - start_time, strlen(delta));
 }
 
 void LcdDisplay::SetPreviewImage(std::unique_ptr<LvglImage> image) {
@@ -676,6 +821,16 @@ void LcdDisplay::SetPreviewImage(std::unique_ptr<LvglImage> image) {
         return;
     }
     
+    // New messages always show up at the end, leave the history if it is being browsed
+    if (chat_history_ != nullptr && chat_window_first_ + chat_rows_.size() != chat_history_->end_id()) {
+        ShowLatestChatMessages();
+    }
+    // Only the latest preview is kept
+    if (chat_image_ != nullptr) {
+        lv_obj_del(chat_image_);
+        chat_image_ = nullptr;
+    }
+
     auto lvgl_theme = static_cast<LvglTheme*>(current_theme_);
     // Create a message bubble for image preview
     lv_obj_t* img_bubble = lv_obj_create(content_);
@@ -746,6 +901,12 @@ void LcdDisplay::SetPreviewImage(std::unique_ptr<LvglImage> image) {
     // Left align the image bubble like assistant messages
     lv_obj_align(img_bubble, LV_ALIGN_LEFT_MID, 0, 0);
 
+    // The preview follows the latest message and moves with it while the history is browsed
+    if (chat_history_ != nullptr) {
+        chat_image_ = img_bubble;
+        chat_image_next_id_ = chat_history_->end_id();
+    }
+
     // Auto-scroll to the image bubble
     lv_obj_scroll_to_view_recursive(img_bubble, LV_ANIM_ON);
 }
@@ -918,11 +1079,11 @@ void LcdDisplay::SetChatMessage(const char* role, const char* content) {
 #endif
 
 void LcdDisplay::SetEmotion(const char* emotion) {
-    // Stop any running GIF animation
+    // Stop any running GIF animation, its decoder stays in the cache
     if (gif_controller_) {
         DisplayLockGuard lock(this);
         gif_controller_->Stop();
-        gif_controller_.reset();
+        gif_controller_ = nullptr;
     }
     
     if (emoji_image_ == nullptr) {
@@ -930,6 +1091,12 @@ void LcdDisplay::SetEmotion(const char* emotion) {
     }
 
     auto emoji_collection = static_cast<LvglTheme*>(current_theme_)->emoji_collection();
+    if (emoji_collection != gif_emoji_collection_) {
+        // The cached decoders belong to the images of the previous collection
+        DisplayLockGuard lock(this);
+        gif_cache_.Clear();
+        gif_emoji_collection_ = emoji_collection;
+    }
     auto image = emoji_collection != nullptr ? emoji_collection->GetEmojiImage(emotion) : nullptr;
     if (image == nullptr) {
         const char* utf8 = font_awesome_get_utf8(emotion);
@@ -943,26 +1110,59 @@ void LcdDisplay::SetEmotion(const char* emotion) {
     }
 
     DisplayLockGuard lock(this);
-    if (image->IsGif()) {
-        // Create new GIF controller
-        gif_controller_ = std::make_unique<LvglGif>(image->image_dsc());
-        
-        if (gif_controller_->IsLoaded()) {
-            // Set up frame update callback
-            gif_controller_->SetFrameCallback([this]() {
-                lv_image_set_src(emoji_image_, gif_controller_->image_dsc());
+    if (image->IsAnimation()) {
+        // Reuse the decoder of a recent emotion, Start() rewinds it to the first frame
+        int64_t start_time = esp_timer_get_time();
+        auto animation = gif_cache_.Get(image);
+        if (animation != nullptr) {
+            gif_controller_ = animation;
+            // Only redraw the part of the canvas the frame changed, the image is shown unscaled
+            animation->SetFrameCallback([this, animation]() {
+                lv_area_t area = animation->dirty_area();
+                lv_area_t coords;
+                lv_obj_get_content_coords(emoji_image_, &coords);
+                lv_area_move(&area, coords.x1, coords.y1);
+                lv_image_cache_drop(animation->image_dsc());
+                lv_obj_invalidate_area(emoji_image_, &area);
             });
             
             // Set initial frame and start animation
-            lv_image_set_src(emoji_image_, gif_controller_->image_dsc());
-            gif_controller_->Start();
+            lv_image_set_src(emoji_image_, animation->image_dsc());
+            animation->Start();
             
             // Show GIF, hide others
             lv_obj_add_flag(emoji_label_, LV_OBJ_FLAG_HIDDEN);
             lv_obj_remove_flag(emoji_image_, LV_OBJ_FLAG_HIDDEN);
+            ESP_LOGD(TAG, "Switched to animated emotion %s in %lld us", emotion, esp_timer_get_time() - start_time);
+
+            // Reopen the most used animations in the background once the switch is done
+            if (gif_prewarm_timer_ == nullptr) {
+                gif_prewarm_timer_ = lv_timer_create([](lv_timer_t* timer) {
+                    auto display = static_cast<LcdDisplay*>(lv_timer_get_user_data(timer));
+                    if (display->gif_prewarm_pending_) {
+                        return;
+                    }
+                    auto image = display->gif_cache_.NextPrewarm();
+                    if (image == nullptr) {
+                        lv_timer_pause(timer);
+                        return;
+                    }
+                    // Opening a GIF decodes its header and allocates the canvas, keep it off the LVGL task
+                    display->gif_prewarm_pending_ = true;
+                    Application::GetInstance().Schedule([display, image, collection = display->gif_emoji_collection_]() {
+                        int64_t start_time = esp_timer_get_time();
+                        auto animation = LvglAnimation::Create(image->image_dsc());
+                        int64_t open_time_us = esp_timer_get_time() - start_time;
+                        DisplayLockGuard lock(display);
+                        display->gif_cache_.AddPrewarmed(image, std::move(animation), open_time_us);
+                        display->gif_prewarm_pending_ = false;
+                    }, kSchedulePriorityBackground);
+                }, 1000, this);
+            }
+            lv_timer_reset(gif_prewarm_timer_);
+            lv_timer_resume(gif_prewarm_timer_);
         } else {
-            ESP_LOGE(TAG, "Failed to load GIF for emotion: %s", emotion);
-            gif_controller_.reset();
+            ESP_LOGE(TAG, "Failed to load animation for emotion: %s", emotion);
         }
     } else {
         lv_image_set_src(emoji_image_, image->image_dsc());
@@ -977,7 +1177,7 @@ void LcdDisplay::SetEmotion(const char* emotion) {
         // Stop GIF animation if running
         if (gif_controller_) {
             gif_controller_->Stop();
-            gif_controller_.reset();
+            gif_controller_ = nullptr;
         }
         
         lv_obj_add_flag(emoji_image_, LV_OBJ_FLAG_HIDDEN);
@@ -986,6 +1186,12 @@ void LcdDisplay::SetEmotion(const char* emotion) {
 #endif
 }
 
+void LcdDisplay::PrintRenderStatistics() {
+    LvglDisplay::PrintRenderStatistics();
+    DisplayLockGuard lock(this);
+    gif_cache_.PrintStatistics();
+}
+
 void LcdDisplay::SetTheme(Theme* theme) {
     DisplayLockGuard lock(this);
     
@@ -1086,16 +1292,14 @@ void LcdDisplay::SetTheme(Theme* theme) {
             // Update border color
             lv_obj_set_style_border_color(bubble, lvgl_theme->border_color(), 0);
             
-            // Update text color for the message
-            if (lv_obj_get_child_cnt(bubble) > 0) {
-                lv_obj_t* text = lv_obj_get_child(bubble, 0);
-                if (text != nullptr) {
-                    // 根据气泡类型设置文本颜色
-                    if (strcmp(bubble_type, "system") == 0) {
-                        lv_obj_set_style_text_color(text, lvgl_theme->system_text_color(), 0);
-                    } else {
-                        lv_obj_set_style_text_color(text, lvgl_theme->text_color(), 0);
-                    }
+            // Update text color for the message, streamed messages have several labels
+            for (uint32_t j = 0; j < lv_obj_get_child_cnt(bubble); j++) {
+                lv_obj_t* text = lv_obj_get_child(bubble, j);
+                // 根据气泡类型设置文本颜色
+                if (strcmp(bubble_type, "system") == 0) {
+                    lv_obj_set_style_text_color(text, lvgl_theme->system_text_color(), 0);
+                } else {
+                    lv_obj_set_style_text_color(text, lvgl_theme->text_color(), 0);
                 }
             }
         } else {
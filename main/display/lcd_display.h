@@ -2,7 +2,8 @@
 #define LCD_DISPLAY_H
 
 #include "lvgl_display.h"
-#include "gif/lvgl_gif.h"
+#include "lvgl_animation_cache.h"
+#include "chat_history.h"
 
 #include <esp_lcd_panel_io.h>
 #include <esp_lcd_panel_ops.h>
@@ -10,9 +11,31 @@
 
 #include <atomic>
 #include <memory>
+#include <deque>
+#include <vector>
 
 #define PREVIEW_IMAGE_DURATION_MS 5000
 
+// LVGL draw buffer layout of SPI LCD displays, the defaults come from CONFIG_LCD_RENDER_MODE
+struct LcdRenderConfig {
+#if CONFIG_LCD_RENDER_MODE_FULL_FRAME_PSRAM
+    int buffer_lines = 0;
+    bool double_buffer = true;
+    bool full_frame_psram = true;
+    int bounce_lines = CONFIG_LCD_RENDER_BOUNCE_LINES;
+#elif CONFIG_LCD_RENDER_MODE_DOUBLE_PARTIAL
+    int buffer_lines = CONFIG_LCD_RENDER_BUFFER_LINES;
+    bool double_buffer = true;
+    bool full_frame_psram = false;
+    int bounce_lines = 0;
+#else
+    int buffer_lines = CONFIG_LCD_RENDER_BUFFER_LINES;
+    bool double_buffer = false;
+    bool full_frame_psram = false;
+    int bounce_lines = 0;
+#endif
+};
+
 
 class LcdDisplay : public LvglDisplay {
 protected:
@@ -27,14 +50,39 @@ protected:
     lv_obj_t* preview_image_ = nullptr;
     lv_obj_t* emoji_label_ = nullptr;
     lv_obj_t* emoji_image_ = nullptr;
-    std::unique_ptr<LvglGif> gif_controller_ = nullptr;
+    // The animation decoder of the current emotion, owned by gif_cache_
+    LvglAnimation* gif_controller_ = nullptr;
+    LvglAnimationCache gif_cache_{CONFIG_EMOJI_GIF_CACHE_KB * 1024};
+    // The cached decoders read the images of this collection
+    std::shared_ptr<EmojiCollection> gif_emoji_collection_;
+    lv_timer_t* gif_prewarm_timer_ = nullptr;
+    // A prewarm open is running in the main loop
+    bool gif_prewarm_pending_ = false;
     lv_obj_t* emoji_box_ = nullptr;
     lv_obj_t* chat_message_label_ = nullptr;
     esp_timer_handle_t preview_timer_ = nullptr;
     std::unique_ptr<LvglImage> preview_image_cached_ = nullptr;
 
+    // Wechat message style: a pool of message rows showing a window of the chat history
+    std::unique_ptr<ChatHistory> chat_history_;
+    std::deque<lv_obj_t*> chat_rows_;
+    std::vector<lv_obj_t*> spare_chat_rows_;
+    uint32_t chat_window_first_ = 0;
+    size_t chat_row_count_ = 0;
+    // The latest image preview, shown in front of history message chat_image_next_id_ while it is in the window
+    lv_obj_t* chat_image_ = nullptr;
+    uint32_t chat_image_next_id_ = 0;
+
     void InitializeLcdThemes();
     void SetupUI();
+    lv_obj_t* CreateChatRow();
+    lv_obj_t* AcquireChatRow();
+    void ReleaseChatRow(lv_obj_t* row);
+    void BindChatRow(lv_obj_t* row, uint32_t id);
+    void SetChatTextWidth(lv_obj_t* text);
+    void PlaceChatImage();
+    void ShowLatestChatMessages();
+    void OnChatScrollEnd();
     virtual bool Lock(int timeout_ms = 0) override;
     virtual void Unlock() override;
 
@@ -46,7 +94,11 @@ public:
     ~LcdDisplay();
     virtual void SetEmotion(const char* emotion) override;
     virtual void SetChatMessage(const char* role, const char* content) override; 
+#if CONFIG_USE_WECHAT_MESSAGE_STYLE
+    virtual void AppendChatText(const char* role, const char* delta) override;
+#endif
     virtual void SetPreviewImage(std::unique_ptr<LvglImage> image) override;
+    virtual void PrintRenderStatistics() override;
 
     // Add theme switching function
     virtual void SetTheme(Theme* theme) override;
@@ -57,7 +109,8 @@ class SpiLcdDisplay : public LcdDisplay {
 public:
     SpiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handle_t panel,
                   int width, int height, int offset_x, int offset_y,
-                  bool mirror_x, bool mirror_y, bool swap_xy);
+                  bool mirror_x, bool mirror_y, bool swap_xy,
+                  const LcdRenderConfig& render_config = LcdRenderConfig());
 };
 
 // RGB LCD显示器
@@ -0,0 +1,187 @@
+#include "lvgl_rle_animation.h"
+#include "tagged_heap.h"
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <algorithm>
+#include <cstring>
+
+#define TAG "LvglRleAnimation"
+
+#define RLE_HEADER_SIZE 16
+#define RLE_FRAME_ENTRY_SIZE 20
+#define RLE_FLAG_ALPHA 0x01
+
+enum RleOp : uint8_t {
+    kRleOpSkip = 0,
+    kRleOpFill = 1,
+    kRleOpCopy = 2,
+};
+
+static inline uint16_t ReadU16(const uint8_t* p) {
+    return p[0] | (p[1] << 8);
+}
+
+static inline uint32_t ReadU32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+LvglRleAnimation::LvglRleAnimation(const lv_img_dsc_t* img_dsc) {
+    if (!img_dsc || !img_dsc->data || img_dsc->data_size < RLE_HEADER_SIZE) {
+        ESP_LOGE(TAG, "Invalid image descriptor");
+        return;
+    }
+    auto data = img_dsc->data;
+    if (memcmp(data, RLE_ANIMATION_MAGIC, 4) != 0 || data[4] != 1) {
+        ESP_LOGE(TAG, "Unsupported animation version %u", data[4]);
+        return;
+    }
+    has_alpha_ = data[5] & RLE_FLAG_ALPHA;
+    width_ = ReadU16(data + 6);
+    height_ = ReadU16(data + 8);
+    frame_count_ = ReadU16(data + 10);
+    loop_count_ = ReadU16(data + 12);
+    if (width_ == 0 || height_ == 0 || frame_count_ == 0 ||
+        img_dsc->data_size < RLE_HEADER_SIZE + frame_count_ * (uint32_t)RLE_FRAME_ENTRY_SIZE) {
+        ESP_LOGE(TAG, "Invalid animation header");
+        return;
+    }
+    // Check the frame table once, so decoding only has to stay inside each frame
+    for (int i = 0; i < frame_count_; i++) {
+        auto entry = data + RLE_HEADER_SIZE + i * RLE_FRAME_ENTRY_SIZE;
+        uint32_t offset = ReadU32(entry);
+        uint32_t size = ReadU32(entry + 4);
+        if (offset > img_dsc->data_size || size > img_dsc->data_size - offset ||
+            ReadU16(entry + 10) + ReadU16(entry + 14) > width_ || ReadU16(entry + 12) + ReadU16(entry + 16) > height_) {
+            ESP_LOGE(TAG, "Invalid frame %d", i);
+            return;
+        }
+    }
+
+    size_t pixels = width_ * height_;
+    size_t canvas_size = pixels * (has_alpha_ ? 3 : 2);
+    canvas_ = (uint8_t*)TaggedHeap::Malloc(kHeapTagDisplay, canvas_size, MALLOC_CAP_SPIRAM);
+    if (canvas_ == nullptr) {
+        canvas_ = (uint8_t*)TaggedHeap::Malloc(kHeapTagDisplay, canvas_size, MALLOC_CAP_8BIT);
+    }
+    if (canvas_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate %u bytes", canvas_size);
+        return;
+    }
+    memset(canvas_, 0, canvas_size);
+    data_ = data;
+
+    // RGB565A8 keeps the alpha plane after the color plane
+    img_dsc_.header.magic = LV_IMAGE_HEADER_MAGIC;
+    img_dsc_.header.flags = LV_IMAGE_FLAGS_MODIFIABLE;
+    img_dsc_.header.cf = has_alpha_ ? LV_COLOR_FORMAT_RGB565A8 : LV_COLOR_FORMAT_RGB565;
+    img_dsc_.header.w = width_;
+    img_dsc_.header.h = height_;
+    img_dsc_.header.stride = width_ * 2;
+    img_dsc_.data = canvas_;
+    img_dsc_.data_size = canvas_size;
+
+    loaded_ = true;
+    ESP_LOGD(TAG, "Animation loaded: %dx%d, %d frames", width_, height_, frame_count_);
+}
+
+LvglRleAnimation::~LvglRleAnimation() {
+    if (canvas_ != nullptr) {
+        TaggedHeap::Free(kHeapTagDisplay, canvas_);
+        canvas_ = nullptr;
+    }
+}
+
+size_t LvglRleAnimation::EstimateSize(const lv_img_dsc_t* img_dsc) {
+    if (img_dsc->data_size < RLE_HEADER_SIZE) {
+        return 0;
+    }
+    auto data = img_dsc->data;
+    size_t pixels = ReadU16(data + 6) * ReadU16(data + 8);
+    return sizeof(LvglRleAnimation) + pixels * ((data[5] & RLE_FLAG_ALPHA) ? 3 : 2);
+}
+
+uint32_t LvglRleAnimation::FrameDelay() const {
+    return delay_;
+}
+
+int LvglRleAnimation::DecodeFrame(lv_area_t& dirty_area) {
+    if (frame_ >= frame_count_) {
+        if (loop_count_ != 0 && ++loops_ >= loop_count_) {
+            lv_area_set(&dirty_area, 0, 0, -1, -1);
+            return 0;
+        }
+        frame_ = 0;
+    }
+
+    auto entry = data_ + RLE_HEADER_SIZE + frame_ * RLE_FRAME_ENTRY_SIZE;
+    auto ops = data_ + ReadU32(entry);
+    auto end = ops + ReadU32(entry + 4);
+    int x = ReadU16(entry + 10);
+    int y = ReadU16(entry + 12);
+    int w = ReadU16(entry + 14);
+    int h = ReadU16(entry + 16);
+    delay_ = ReadU16(entry + 8);
+    ApplyOps(ops, end, x, y, w, h);
+    lv_area_set(&dirty_area, x, y, x + w - 1, y + h - 1);
+    frame_++;
+    return 1;
+}
+
+void LvglRleAnimation::Rewind() {
+    frame_ = 0;
+    loops_ = 0;
+}
+
+void LvglRleAnimation::ApplyOps(const uint8_t* ops, const uint8_t* end, int x, int y, int w, int h) {
+    auto color = reinterpret_cast<uint16_t*>(canvas_);
+    auto alpha = canvas_ + width_ * height_ * 2;
+    int pixel_size = has_alpha_ ? 3 : 2;
+    int remaining = w * h;
+    int col = 0;
+    int row = 0;
+
+    while (ops < end && remaining > 0) {
+        uint8_t op = *ops++;
+        int type = op >> 6;
+        int count = std::min((op & 0x3F) + 1, remaining);
+        const uint8_t* pixel = ops;
+        if (type == kRleOpFill) {
+            ops += pixel_size;
+        } else if (type == kRleOpCopy) {
+            ops += count * pixel_size;
+        }
+        if (ops > end) {
+            ESP_LOGW(TAG, "Frame data is truncated");
+            return;
+        }
+        remaining -= count;
+
+        // Ops run across the rows of the rect, write them one row segment at a time
+        while (count > 0) {
+            int n = std::min(count, w - col);
+            size_t index = (y + row) * width_ + x + col;
+            if (type == kRleOpFill) {
+                std::fill_n(color + index, n, ReadU16(pixel));
+                if (has_alpha_) {
+                    memset(alpha + index, pixel[2], n);
+                }
+            } else if (type == kRleOpCopy) {
+                if (has_alpha_) {
+                    for (int i = 0; i < n; i++, pixel += 3) {
+                        color[index + i] = ReadU16(pixel);
+                        alpha[index + i] = pixel[2];
+                    }
+                } else {
+                    memcpy(color + index, pixel, n * 2);
+                    pixel += n * 2;
+                }
+            }
+            count -= n;
+            col += n;
+            if (col == w) {
+                col = 0;
+                row++;
+            }
+        }
+    }
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "../lvgl_animation.h"
+#include <lvgl.h>
+
+#define RLE_ANIMATION_MAGIC "RLEA"
+
+/**
+ * Plays the pre-decoded animations made by scripts/spiffs_assets/gif_to_rla.py
+ * straight from the (memory mapped) asset data into one RGB565 or RGB565A8 canvas.
+ *
+ * All numbers are little endian.
+ *   Header, 16 bytes: magic "RLEA", uint8 version (1), uint8 flags (bit 0: alpha),
+ *       uint16 width, height, frame count, loop count (0 = forever), reserved
+ *   Frame table, 20 bytes per frame: uint32 offset from the start of the data, uint32 size,
+ *       uint16 delay in ms, uint16 x, y, w, h of the changed rect, uint16 reserved
+ *   Frame data: run length ops over the rect pixels in raster order. An op byte holds the
+ *       type in bits 7-6 (0 skip, 1 fill, 2 copy) and the pixel count - 1 in bits 5-0.
+ *       Fill is followed by one pixel, copy by count pixels. A pixel is an RGB565 word,
+ *       followed by an alpha byte if the alpha flag is set.
+ * The first frame covers the whole canvas without skips, so looping needs no reset.
+ */
+class LvglRleAnimation : public LvglAnimation {
+public:
+    explicit LvglRleAnimation(const lv_img_dsc_t* img_dsc);
+    virtual ~LvglRleAnimation();
+
+    /**
+     * Memory of the canvas for the animation data
+     */
+    static size_t EstimateSize(const lv_img_dsc_t* img_dsc);
+
+protected:
+    virtual uint32_t FrameDelay() const override;
+    virtual int DecodeFrame(lv_area_t& dirty_area) override;
+    virtual void Rewind() override;
+
+private:
+    const uint8_t* data_ = nullptr;
+    uint8_t* canvas_ = nullptr;
+    uint16_t width_ = 0;
+    uint16_t height_ = 0;
+    bool has_alpha_ = false;
+    uint16_t frame_count_ = 0;
+    uint16_t loop_count_ = 0;
+    uint16_t frame_ = 0;
+    uint16_t loops_ = 0;
+    uint32_t delay_ = 0;
+
+    void ApplyOps(const uint8_t* ops, const uint8_t* end, int x, int y, int w, int h);
+};
@@ -47,6 +47,24 @@ read_num(gd_GIF * gif)
     return bytes[0] + (((uint16_t) bytes[1]) << 8);
 }
 
+static inline uint32_t
+argb_word(const uint8_t * color, uint8_t opa)
+{
+    return ((uint32_t) opa << 24) | ((uint32_t) color[0] << 16) | ((uint32_t) color[1] << 8) | color[2];
+}
+
+static void
+fill_rect(uint32_t * buffer, int w, int h, int stride, uint32_t color)
+{
+    int j, k;
+
+    for(j = 0; j < h; j++) {
+        for(k = 0; k < w; k++)
+            buffer[k] = color;
+        buffer += stride;
+    }
+}
+
 gd_GIF *
 gd_open_gif_file(const char * fname)
 {
@@ -152,12 +170,8 @@ static gd_GIF * gif_open(gd_GIF * gif_base)
 #ifdef GIFDEC_FILL_BG
     GIFDEC_FILL_BG(gif->canvas, gif->width * gif->height, 1, gif->width * gif->height, bgcolor, 0x00);
 #else
-    for(int i = 0; i < gif->width * gif->height; i++) {
-        gif->canvas[i * 4 + 0] = *(bgcolor + 2);
-        gif->canvas[i * 4 + 1] = *(bgcolor + 1);
-        gif->canvas[i * 4 + 2] = *(bgcolor + 0);
-        gif->canvas[i * 4 + 3] = 0x00;  // 初始化为透明，让第一帧根据自己的透明度设置来渲染
-    }
+    // 初始化为透明，让第一帧根据自己的透明度设置来渲染
+    fill_rect((uint32_t *) gif->canvas, gif->width, gif->height, gif->width, argb_word(bgcolor, 0x00));
 #endif
     gif->anim_start = f_gif_seek(gif, 0, LV_FS_SEEK_CUR);
     gif->loop_count = -1;
@@ -478,21 +492,25 @@ read_image_data(gd_GIF *gif, int interlace)
     return ret;
 }
 #else
+/* Reset the code table kept in gif, it is only (re)allocated when it has to grow. */
 static Table *
-new_table(int key_size)
+reset_table(gd_GIF * gif, int key_size)
 {
     int key;
     int init_bulk = MAX(1 << (key_size + 1), 0x100);
-    Table * table = lv_malloc(sizeof(*table) + sizeof(Entry) * init_bulk);
-    if(table) {
+    Table * table = gif->lzw_table;
+    if(!table || table->bulk < init_bulk) {
+        table = lv_realloc(table, sizeof(*table) + sizeof(Entry) * init_bulk);
+        if(!table) return NULL;
         table->bulk = init_bulk;
-        table->nentries = (1 << key_size) + 2;
         table->entries = (Entry *) &table[1];
-        for(key = 0; key < (1 << key_size); key++)
-            table->entries[key] = (Entry) {
-            1, 0xFFF, key
-        };
+        gif->lzw_table = table;
     }
+    table->nentries = (1 << key_size) + 2;
+    for(key = 0; key < (1 << key_size); key++)
+        table->entries[key] = (Entry) {
+        1, 0xFFF, key
+    };
     return table;
 }
 
@@ -553,6 +571,7 @@ read_image_data(gd_GIF * gif, int interlace)
     uint16_t key, clear, stop;
     int ret;
     Table * table;
+    uint8_t * row;
     Entry entry = {0};
     size_t start, end;
 
@@ -564,7 +583,8 @@ read_image_data(gd_GIF * gif, int interlace)
     f_gif_seek(gif, start, LV_FS_SEEK_SET);
     clear = 1 << key_size;
     stop = clear + 1;
-    table = new_table(key_size);
+    table = reset_table(gif, key_size);
+    if(!table) return -1;
     key_size++;
     init_key_size = key_size;
     sub_len = shift = 0;
@@ -580,10 +600,8 @@ read_image_data(gd_GIF * gif, int interlace)
         }
         else if(!table_is_full) {
             ret = add_entry(&table, str_len + 1, key, entry.suffix);
-            if(ret == -1) {
-                lv_free(table);
-                return -1;
-            }
+            gif->lzw_table = table;
+            if(ret == -1) return -1;
             if(table->nentries == 0x1000) {
                 ret = 0;
                 table_is_full = 1;
@@ -595,28 +613,32 @@ read_image_data(gd_GIF * gif, int interlace)
         if(ret == 1) key_size++;
         entry = table->entries[key];
         str_len = entry.length;
-	if(frm_off + str_len > frm_size){
-		ESP_LOGW(TAG, "LZW table token overflows the frame buffer");
-		lv_free(table);
-		return -1;
-	}
+        if(frm_off + str_len > frm_size) {
+            ESP_LOGW(TAG, "LZW table token overflows the frame buffer");
+            return -1;
+        }
+        /* The string is written backwards from its last pixel, only divide once per string and line. */
+        p = frm_off + str_len - 1;
+        x = p % gif->fw;
+        y = p / gif->fw;
+        row = &gif->frame[(gif->fy + (interlace ? interlaced_line_index((int) gif->fh, y) : y)) * gif->width + gif->fx];
         for(i = 0; i < str_len; i++) {
-            p = frm_off + entry.length - 1;
-            x = p % gif->fw;
-            y = p / gif->fw;
-            if(interlace)
-                y = interlaced_line_index((int) gif->fh, y);
-            gif->frame[(gif->fy + y) * gif->width + gif->fx + x] = entry.suffix;
+            row[x] = entry.suffix;
             if(entry.prefix == 0xFFF)
                 break;
             else
                 entry = table->entries[entry.prefix];
+            if(x == 0) {
+                x = gif->fw;
+                y--;
+                row = &gif->frame[(gif->fy + (interlace ? interlaced_line_index((int) gif->fh, y) : y)) * gif->width + gif->fx];
+            }
+            x--;
         }
         frm_off += str_len;
         if(key < table->nentries - 1 && !table_is_full)
             table->entries[table->nentries - 1].suffix = entry.suffix;
     }
-    lv_free(table);
     if(key == stop) f_gif_read(gif, &sub_len, 1);  /* Must be zero! */
     f_gif_seek(gif, end, LV_FS_SEEK_SET);
     return 0;
@@ -653,6 +675,12 @@ read_image(gd_GIF * gif)
     }
     else
         gif->palette = &gif->gct;
+    /* The local color table may differ on every frame. */
+    if(gif->lut_palette != gif->palette || gif->palette == &gif->lct) {
+        for(int i = 0; i < gif->palette->size; i++)
+            gif->palette_lut[i] = argb_word(&gif->palette->colors[i * 3], 0xFF);
+        gif->lut_palette = gif->palette;
+    }
     /* Image Data. */
     return read_image_data(gif, interlace);
 }
@@ -666,21 +694,32 @@ render_frame_rect(gd_GIF * gif, uint8_t * buffer)
                         &gif->frame[i], gif->palette->colors,
                         gif->gce.transparency ? gif->gce.tindex : 0x100);
 #else
+    /* Look up whole ARGB8888 words instead of converting the palette byte by byte. */
     int j, k;
-    uint8_t index, * color;
+    const uint32_t * lut = gif->palette_lut;
+    const uint8_t * src = &gif->frame[i];
+    uint32_t * dst = (uint32_t *) buffer + i;
+    int tindex = gif->gce.transparency ? gif->gce.tindex : 0x100;
 
     for(j = 0; j < gif->fh; j++) {
-        for(k = 0; k < gif->fw; k++) {
-            index = gif->frame[(gif->fy + j) * gif->width + gif->fx + k];
-            color = &gif->palette->colors[index * 3];
-            if(!gif->gce.transparency || index != gif->gce.tindex) {
-                buffer[(i + k) * 4 + 0] = *(color + 2);
-                buffer[(i + k) * 4 + 1] = *(color + 1);
-                buffer[(i + k) * 4 + 2] = *(color + 0);
-                buffer[(i + k) * 4 + 3] = 0xFF;
+        if(tindex > 0xFF) {
+            for(k = 0; k + 4 <= gif->fw; k += 4) {
+                dst[k + 0] = lut[src[k + 0]];
+                dst[k + 1] = lut[src[k + 1]];
+                dst[k + 2] = lut[src[k + 2]];
+                dst[k + 3] = lut[src[k + 3]];
             }
+            for(; k < gif->fw; k++)
+                dst[k] = lut[src[k]];
         }
-        i += gif->width;
+        else {
+            for(k = 0; k < gif->fw; k++) {
+                if(src[k] != tindex)
+                    dst[k] = lut[src[k]];
+            }
+        }
+        src += gif->width;
+        dst += gif->width;
     }
 #endif
 }
@@ -701,24 +740,17 @@ dispose(gd_GIF * gif)
 #ifdef GIFDEC_FILL_BG
             GIFDEC_FILL_BG(&(gif->canvas[i * 4]), gif->fw, gif->fh, gif->width, bgcolor, opa);
 #else
-            int j, k;
-            for(j = 0; j < gif->fh; j++) {
-                for(k = 0; k < gif->fw; k++) {
-                    gif->canvas[(i + k) * 4 + 0] = *(bgcolor + 2);
-                    gif->canvas[(i + k) * 4 + 1] = *(bgcolor + 1);
-                    gif->canvas[(i + k) * 4 + 2] = *(bgcolor + 0);
-                    gif->canvas[(i + k) * 4 + 3] = opa;
-                }
-                i += gif->width;
-            }
+            fill_rect((uint32_t *) gif->canvas + i, gif->fw, gif->fh, gif->width, argb_word(bgcolor, opa));
 #endif
             break;
         case 3: /* Restore to previous, i.e., don't update canvas.*/
             break;
         default:
             /* Add frame non-transparent pixels to canvas. */
-            render_frame_rect(gif, gif->canvas);
+            if(!gif->rendered)
+                render_frame_rect(gif, gif->canvas);
     }
+    gif->rendered = 0;
 }
 
 /* Return 1 if got a frame; 0 if got GIF trailer; -1 if error. */
@@ -753,19 +785,40 @@ void
 gd_render_frame(gd_GIF * gif, uint8_t * buffer)
 {
     render_frame_rect(gif, buffer);
+    if(buffer == gif->canvas)
+        gif->rendered = 1;
 }
 
 void
 gd_rewind(gd_GIF * gif)
 {
+    uint8_t * bgcolor;
+
     gif->loop_count = -1;
     f_gif_seek(gif, gif->anim_start, LV_FS_SEEK_SET);
+
+    /* 回到 gd_open_gif_data 之后的状态，上一轮的最后一帧不再参与 dispose */
+    gif->palette = &gif->gct;
+    memset(&gif->gce, 0, sizeof(gif->gce));
+    gif->rendered = 1;
+    if(gif->bgindex) {
+        memset(gif->frame, gif->bgindex, gif->width * gif->height);
+    }
+    bgcolor = &gif->palette->colors[gif->bgindex * 3];
+#ifdef GIFDEC_FILL_BG
+    GIFDEC_FILL_BG(gif->canvas, gif->width * gif->height, 1, gif->width * gif->height, bgcolor, 0x00);
+#else
+    fill_rect((uint32_t *) gif->canvas, gif->width, gif->height, gif->width, argb_word(bgcolor, 0x00));
+#endif
 }
 
 void
 gd_close_gif(gd_GIF * gif)
 {
     f_gif_close(gif);
+#if !LV_GIF_CACHE_DECODE_DATA
+    lv_free(gif->lzw_table);
+#endif
     lv_free(gif);
 }
 
@@ -46,8 +46,16 @@ typedef struct _gd_GIF {
     uint16_t fx, fy, fw, fh;
     uint8_t bgindex;
     uint8_t * canvas, * frame;
+    /* ARGB8888 words of the current palette, rebuilt when the palette changes */
+    uint32_t palette_lut[0x100];
+    gd_Palette * lut_palette;
+    /* The canvas already holds the current frame, so dispose() needn't draw it again */
+    uint8_t rendered;
 #if LV_GIF_CACHE_DECODE_DATA
     uint8_t *lzw_cache;
+#else
+    /* LZW code table kept across frames, grown on demand */
+    void * lzw_table;
 #endif
 } gd_GIF;
 
@@ -55,6 +63,7 @@ gd_GIF * gd_open_gif_file(const char * fname);
 
 gd_GIF * gd_open_gif_data(const void * data);
 
+/* The buffer is ARGB8888 and must be 4 byte aligned */
 void gd_render_frame(gd_GIF * gif, uint8_t * buffer);
 
 int gd_get_frame(gd_GIF * gif);
@@ -4,8 +4,7 @@
 
 #define TAG "LvglGif"
 
-LvglGif::LvglGif(const lv_img_dsc_t* img_dsc)
-    : gif_(nullptr), timer_(nullptr), last_call_(0), playing_(false), loaded_(false) {
+LvglGif::LvglGif(const lv_img_dsc_t* img_dsc) : gif_(nullptr) {
     if (!img_dsc || !img_dsc->data) {
         ESP_LOGE(TAG, "Invalid image descriptor");
         return;
@@ -37,86 +36,23 @@ LvglGif::LvglGif(const lv_img_dsc_t* img_dsc)
     ESP_LOGD(TAG, "GIF loaded from image descriptor: %dx%d", gif_->width, gif_->height);
 }
 
-// Destructor
 LvglGif::~LvglGif() {
-    Cleanup();
-}
-
-// LvglImage interface implementation
-const lv_img_dsc_t* LvglGif::image_dsc() const {
-    if (!loaded_) {
-        return nullptr;
-    }
-    return &img_dsc_;
-}
-
-// Animation control methods
-void LvglGif::Start() {
-    if (!loaded_ || !gif_) {
-        ESP_LOGW(TAG, "GIF not loaded, cannot start");
-        return;
-    }
-
-    if (!timer_) {
-        timer_ = lv_timer_create([](lv_timer_t* timer) {
-            LvglGif* gif_obj = static_cast<LvglGif*>(lv_timer_get_user_data(timer));
-            gif_obj->NextFrame();
-        }, 10, this);
-    }
-
-    if (timer_) {
-        playing_ = true;
-        last_call_ = lv_tick_get();
-        lv_timer_resume(timer_);
-        lv_timer_reset(timer_);
-        
-        // Render first frame
-        NextFrame();
-        
-        ESP_LOGD(TAG, "GIF animation started");
-    }
-}
-
-void LvglGif::Pause() {
-    if (timer_) {
-        playing_ = false;
-        lv_timer_pause(timer_);
-        ESP_LOGD(TAG, "GIF animation paused");
-    }
-}
-
-void LvglGif::Resume() {
-    if (!loaded_ || !gif_) {
-        ESP_LOGW(TAG, "GIF not loaded, cannot resume");
-        return;
-    }
-
-    if (timer_) {
-        playing_ = true;
-        lv_timer_resume(timer_);
-        ESP_LOGD(TAG, "GIF animation resumed");
-    }
-}
-
-void LvglGif::Stop() {
-    if (timer_) {
-        playing_ = false;
-        lv_timer_pause(timer_);
-    }
-
+    // Close GIF decoder
     if (gif_) {
-        gd_rewind(gif_);
-        NextFrame();
-        ESP_LOGD(TAG, "GIF animation stopped and rewound");
+        gd_close_gif(gif_);
+        gif_ = nullptr;
     }
 }
 
-bool LvglGif::IsPlaying() const {
-    return playing_;
-}
-
-bool LvglGif::IsLoaded() const {
-    return loaded_;
+size_t LvglGif::EstimateSize(const lv_img_dsc_t* img_dsc) {
+    // The decoder keeps an ARGB8888 canvas and an index buffer of the logical screen size
+    if (img_dsc->data_size < 10) {
+        return 0;
+    }
+    auto data = img_dsc->data;
+    size_t width = data[6] | (data[7] << 8);
+    size_t height = data[8] | (data[9] << 8);
+    return sizeof(gd_GIF) + width * height * 5;
 }
 
 int32_t LvglGif::GetLoopCount() const {
@@ -134,75 +70,28 @@ void LvglGif::SetLoopCount(int32_t count) {
     gif_->loop_count = count;
 }
 
-uint16_t LvglGif::width() const {
-    if (!loaded_ || !gif_) {
-        return 0;
-    }
-    return gif_->width;
+uint32_t LvglGif::FrameDelay() const {
+    return gif_->gce.delay * 10;
 }
 
-uint16_t LvglGif::height() const {
-    if (!loaded_ || !gif_) {
-        return 0;
-    }
-    return gif_->height;
-}
-
-void LvglGif::SetFrameCallback(std::function<void()> callback) {
-    frame_callback_ = callback;
-}
-
-void LvglGif::NextFrame() {
-    if (!loaded_ || !gif_ || !playing_) {
-        return;
-    }
-
-    // Check if enough time has passed for the next frame
-    uint32_t elapsed = lv_tick_elaps(last_call_);
-    if (elapsed < gif_->gce.delay * 10) {
-        return;
-    }
-
-    last_call_ = lv_tick_get();
+int LvglGif::DecodeFrame(lv_area_t& dirty_area) {
+    // Disposal 2 clears the previous frame rect, the new frame only draws its own rect
+    bool clear_previous = gif_->gce.disposal == 2;
+    lv_area_t previous;
+    lv_area_set(&previous, gif_->fx, gif_->fy, gif_->fx + gif_->fw - 1, gif_->fy + gif_->fh - 1);
 
     // Get next frame
     int has_next = gd_get_frame(gif_);
-    if (has_next == 0) {
-        // Animation finished, pause timer
-        playing_ = false;
-        if (timer_) {
-            lv_timer_pause(timer_);
-        }
-        ESP_LOGD(TAG, "GIF animation completed");
-    }
 
     // Render current frame
-    if (gif_->canvas) {
-        gd_render_frame(gif_, gif_->canvas);
-        
-        // Call frame callback if set
-        if (frame_callback_) {
-            frame_callback_();
-        }
+    gd_render_frame(gif_, gif_->canvas);
+    lv_area_set(&dirty_area, gif_->fx, gif_->fy, gif_->fx + gif_->fw - 1, gif_->fy + gif_->fh - 1);
+    if (clear_previous && lv_area_get_size(&previous) > 0) {
+        lv_area_join(&dirty_area, &dirty_area, &previous);
     }
+    return has_next;
 }
 
-void LvglGif::Cleanup() {
-    // Stop and delete timer
-    if (timer_) {
-        lv_timer_delete(timer_);
-        timer_ = nullptr;
-    }
-
-    // Close GIF decoder
-    if (gif_) {
-        gd_close_gif(gif_);
-        gif_ = nullptr;
-    }
-
-    playing_ = false;
-    loaded_ = false;
-    
-    // Clear image descriptor
-    memset(&img_dsc_, 0, sizeof(img_dsc_));
+void LvglGif::Rewind() {
+    gd_rewind(gif_);
 }
@@ -1,6 +1,7 @@
 #include <esp_attr.h>
 #include <esp_heap_caps.h>
 #include <esp_log.h>
+#include <esp_timer.h>
 #include <stddef.h>
 #include <string.h>
 
@@ -32,45 +33,41 @@ static __always_inline uint8_t expand_6_to_8(uint8_t v) {
     return (uint8_t)((v << 2) | (v >> 4));
 }
 
-static uint8_t* convert_input_to_encoder_buf(const uint8_t* src, uint16_t width, uint16_t height, v4l2_pix_fmt_t format,
-                                             jpeg_pixel_format_t* out_fmt, int* out_size) {
-    // 直接支持的格式：GRAY、RGB888、YCbYCr(YUYV)
+// 编码器输入格式：GRAY、YCbYCr(YUYV) 直接支持，其余格式转换为 RGB888
+static jpeg_pixel_format_t get_encoder_format(v4l2_pix_fmt_t format, int* bytes_per_pixel) {
     if (format == V4L2_PIX_FMT_GREY) {
-        int sz = (int)width * (int)height;
-        uint8_t* buf = (uint8_t*)jpeg_calloc_align(sz, 16);
-        if (!buf)
-            return NULL;
-        memcpy(buf, src, sz);
-        if (out_fmt)
-            *out_fmt = JPEG_PIXEL_FORMAT_GRAY;
-        if (out_size)
-            *out_size = sz;
-        return buf;
+        *bytes_per_pixel = 1;
+        return JPEG_PIXEL_FORMAT_GRAY;
+    }
+    if (format == V4L2_PIX_FMT_YUYV || format == V4L2_PIX_FMT_UYVY || format == V4L2_PIX_FMT_YUV422P) {
+        *bytes_per_pixel = 2;
+        return JPEG_PIXEL_FORMAT_YCbYCr;
+    }
+    *bytes_per_pixel = 3;
+    return JPEG_PIXEL_FORMAT_RGB888;
+}
+
+// 将第 y 行开始的 lines 行转换为编码器输入格式，写入 dst
+static void convert_rows_to_encoder_buf(const uint8_t* src, uint16_t width, uint16_t height, int y, int lines,
+                                        v4l2_pix_fmt_t format, uint8_t* dst) {
+    int pixels = (int)width * lines;
+
+    if (format == V4L2_PIX_FMT_GREY) {
+        memcpy(dst, src + y * (int)width, pixels);
+        return;
     }
 
     // V4L2 YUYV (Y Cb Y Cr) 可直接作为 JPEG_PIXEL_FORMAT_YCbYCr 输入
     if (format == V4L2_PIX_FMT_YUYV) {
-        int sz = (int)width * (int)height * 2;
-        uint8_t* buf = (uint8_t*)jpeg_calloc_align(sz, 16);
-        if (!buf)
-            return NULL;
-        memcpy(buf, src, sz);
-        if (out_fmt)
-            *out_fmt = JPEG_PIXEL_FORMAT_YCbYCr;
-        if (out_size)
-            *out_size = sz;
-        return buf;
+        memcpy(dst, src + y * (int)width * 2, pixels * 2);
+        return;
     }
 
     // V4L2 UYVY (Cb Y Cr Y) -> 重排为 YUYV 再作为 YCbYCr 输入
     if (format == V4L2_PIX_FMT_UYVY) {
-        int sz = (int)width * (int)height * 2;
-        const uint8_t* s = src;
-        uint8_t* buf = (uint8_t*)jpeg_calloc_align(sz, 16);
-        if (!buf)
-            return NULL;
-        uint8_t* d = buf;
-        for (int i = 0; i < sz; i += 4) {
+        const uint8_t* s = src + y * (int)width * 2;
+        uint8_t* d = dst;
+        for (int i = 0; i < pixels * 2; i += 4) {
             // src: Cb, Y0, Cr, Y1 -> dst: Y0, Cb, Y1, Cr
             d[0] = s[1];
             d[1] = s[0];
@@ -79,63 +76,42 @@ static uint8_t* convert_input_to_encoder_buf(const uint8_t* src, uint16_t width,
             s += 4;
             d += 4;
         }
-        if (out_fmt)
-            *out_fmt = JPEG_PIXEL_FORMAT_YCbYCr;
-        if (out_size)
-            *out_size = sz;
-        return buf;
+        return;
     }
 
     // V4L2 YUV422P (YUV422 Planar) -> 重排为 YUYV (YCbYCr)
     if (format == V4L2_PIX_FMT_YUV422P) {
-        int sz = (int)width * (int)height * 2;
         const uint8_t* y_plane = src;
         const uint8_t* u_plane = y_plane + (int)width * (int)height;
         const uint8_t* v_plane = u_plane + ((int)width / 2) * (int)height;
-        uint8_t* buf = (uint8_t*)jpeg_calloc_align(sz, 16);
-        if (!buf)
-            return NULL;
-        uint8_t* dst = buf;
-        for (int y = 0; y < height; y++) {
-            const uint8_t* y_row = y_plane + y * (int)width;
-            const uint8_t* u_row = u_plane + y * ((int)width / 2);
-            const uint8_t* v_row = v_plane + y * ((int)width / 2);
+        uint8_t* d = dst;
+        for (int row = y; row < y + lines; row++) {
+            const uint8_t* y_row = y_plane + row * (int)width;
+            const uint8_t* u_row = u_plane + row * ((int)width / 2);
+            const uint8_t* v_row = v_plane + row * ((int)width / 2);
             for (int x = 0; x < width; x += 2) {
-                uint8_t y0 = y_row[x + 0];
-                uint8_t y1 = y_row[x + 1];
-                uint8_t cb = u_row[x / 2];
-                uint8_t cr = v_row[x / 2];
-                dst[0] = y0;
-                dst[1] = cb;
-                dst[2] = y1;
-                dst[3] = cr;
-                dst += 4;
+                d[0] = y_row[x + 0];
+                d[1] = u_row[x / 2];
+                d[2] = y_row[x + 1];
+                d[3] = v_row[x / 2];
+                d += 4;
             }
         }
-        if (out_fmt)
-            *out_fmt = JPEG_PIXEL_FORMAT_YCbYCr;
-        if (out_size)
-            *out_size = sz;
-        return buf;
+        return;
     }
 
     // 其余格式转换为 RGB888
-    int rgb_size = (int)width * (int)height * 3;
-    uint8_t* rgb = (uint8_t*)jpeg_calloc_align(rgb_size, 16);
-    if (!rgb)
-        return NULL;
-
     if (format == V4L2_PIX_FMT_RGB24) {
         // V4L2_RGB24 即 RGB888
-        memcpy(rgb, src, rgb_size);
-    } else if (format == V4L2_PIX_FMT_RGB565) {
-        // RGB565 小端，需要转换为 RGB888
-        const uint8_t* p = src;
-        uint8_t* d = rgb;
-        int pixels = (int)width * (int)height;
+        memcpy(dst, src + y * (int)width * 3, pixels * 3);
+    } else if (format == V4L2_PIX_FMT_RGB565 || format == V4L2_PIX_FMT_RGB565X) {
+        // RGB565 为小端，RGB565X 为大端，转换为 RGB888
+        const uint8_t* p = src + y * (int)width * 2;
+        uint8_t* d = dst;
+        int hi_index = (format == V4L2_PIX_FMT_RGB565) ? 1 : 0;
         for (int i = 0; i < pixels; i++) {
-            uint8_t lo = p[0];  // 低字节（LSB）
-            uint8_t hi = p[1];  // 高字节（MSB）
+            uint8_t hi = p[hi_index];      // 高字节（MSB）
+            uint8_t lo = p[1 - hi_index];  // 低字节（LSB）
             p += 2;
 
             uint8_t r5 = (hi >> 3) & 0x1F;
@@ -149,14 +125,8 @@ static uint8_t* convert_input_to_encoder_buf(const uint8_t* src, uint16_t width,
         }
     } else {
         // 其他未覆盖格式，清零
-        memset(rgb, 0, rgb_size);
+        memset(dst, 0, pixels * 3);
     }
-
-    if (out_fmt)
-        *out_fmt = JPEG_PIXEL_FORMAT_RGB888;
-    if (out_size)
-        *out_size = rgb_size;
-    return rgb;
 }
 
 #if CONFIG_XIAOZHI_ENABLE_HARDWARE_JPEG_ENCODER
@@ -222,6 +192,23 @@ static uint8_t* convert_input_to_hw_encoder_buf(const uint8_t* src, uint16_t wid
         return buf;
     }
 
+    if (format == V4L2_PIX_FMT_RGB565X) {
+        // 大端 RGB565，逐像素交换字节
+        int sz = (int)width * (int)height * 2;
+        uint16_t* buf = (uint16_t*)malloc_psram(sz);
+        if (!buf)
+            return NULL;
+        const uint16_t* bsrc = (const uint16_t*)src;
+        for (int i = 0; i < sz / 2; i++) {
+            buf[i] = __builtin_bswap16(bsrc[i]);
+        }
+        if (out_fmt)
+            *out_fmt = JPEG_ENCODE_IN_FORMAT_RGB565;
+        if (out_size)
+            *out_size = sz;
+        return (uint8_t*)buf;
+    }
+
     if (format == V4L2_PIX_FMT_YUYV) {
         // 硬件需要 | Y1 V Y0 U | 的“大端”格式，因此需要 bswap16
         int sz = (int)width * (int)height * 2;
@@ -322,13 +309,9 @@ static bool encode_with_esp_new_jpeg(const uint8_t* src, size_t src_len, uint16_
     if (quality > 100)
         quality = 100;
 
-    jpeg_pixel_format_t enc_src_type = JPEG_PIXEL_FORMAT_RGB888;
-    int enc_in_size = 0;
-    uint8_t* enc_in = convert_input_to_encoder_buf(src, width, height, format, &enc_src_type, &enc_in_size);
-    if (!enc_in) {
-        ESP_LOGE(TAG, "alloc/convert input failed");
-        return false;
-    }
+    int64_t start_time = esp_timer_get_time();
+    int bytes_per_pixel = 3;
+    jpeg_pixel_format_t enc_src_type = get_encoder_format(format, &bytes_per_pixel);
 
     jpeg_enc_config_t cfg = DEFAULT_JPEG_ENC_CONFIG();
     cfg.width = width;
@@ -342,11 +325,27 @@ static bool encode_with_esp_new_jpeg(const uint8_t* src, size_t src_len, uint16_
     jpeg_enc_handle_t h = NULL;
     jpeg_error_t ret = jpeg_enc_open(&cfg, &h);
     if (ret != JPEG_ERR_OK) {
-        jpeg_free_align(enc_in);
         ESP_LOGE(TAG, "jpeg_enc_open failed: %d", (int)ret);
         return false;
     }
 
+    // 按 MCU 行分块编码（420 为 16 行，GRAY 为 8 行），每次只转换一块输入，无需整帧的转换缓冲区
+    int block_size = 0;
+    int row_size = (int)width * bytes_per_pixel;
+    ret = jpeg_enc_get_block_size(h, &block_size);
+    if (ret != JPEG_ERR_OK || block_size <= 0 || block_size % row_size != 0) {
+        jpeg_enc_close(h);
+        ESP_LOGE(TAG, "unexpected block size: %d", block_size);
+        return false;
+    }
+    int block_lines = block_size / row_size;
+    uint8_t* block = (uint8_t*)jpeg_calloc_align(block_size, 16);
+    if (!block) {
+        jpeg_enc_close(h);
+        ESP_LOGE(TAG, "alloc block buffer failed");
+        return false;
+    }
+
     // 估算输出缓冲区：宽高的 1.5 倍 + 64KB
     size_t out_cap = (size_t)width * (size_t)height * 3 / 2 + 64 * 1024;
     if (out_cap < 128 * 1024)
@@ -354,25 +353,47 @@ static bool encode_with_esp_new_jpeg(const uint8_t* src, size_t src_len, uint16_
     uint8_t* outbuf = (uint8_t*)malloc_psram(out_cap);
     if (!outbuf) {
         jpeg_enc_close(h);
-        jpeg_free_align(enc_in);
+        jpeg_free_align(block);
         ESP_LOGE(TAG, "alloc out buffer failed");
         return false;
     }
 
+    // 编码器把整张 JPEG 依次写入 outbuf，每块编码后把新增的数据交给回调，编码与发送可以重叠
     int out_len = 0;
-    ret = jpeg_enc_process(h, enc_in, enc_in_size, outbuf, (int)out_cap, &out_len);
+    int sent = 0;
+    size_t chunk_index = 0;
+    for (int y = 0; y < height; y += block_lines) {
+        int lines = height - y < block_lines ? height - y : block_lines;
+        convert_rows_to_encoder_buf(src, width, height, y, lines, format, block);
+        // 最后一块不足 MCU 高度时重复最后一行
+        for (int i = lines; i < block_lines; i++) {
+            memcpy(block + i * row_size, block + (lines - 1) * row_size, row_size);
+        }
+        ret = jpeg_enc_process_with_block(h, block, block_size, outbuf, (int)out_cap, &out_len);
+        if (ret < JPEG_ERR_OK) {
+            break;
+        }
+        if (cb && out_len > sent) {
+            cb(cb_arg, chunk_index++, outbuf + sent, (size_t)(out_len - sent));
+            sent = out_len;
+        }
+    }
     jpeg_enc_close(h);
-    jpeg_free_align(enc_in);
+    jpeg_free_align(block);
 
-    if (ret != JPEG_ERR_OK) {
+    if (ret < JPEG_ERR_OK) {
         free(outbuf);
-        ESP_LOGE(TAG, "jpeg_enc_process failed: %d", (int)ret);
+        ESP_LOGE(TAG, "jpeg_enc_process_with_block failed: %d", (int)ret);
         return false;
     }
+    ESP_LOGI(TAG, "Encoded %ux%u to %d bytes in %lld ms, block buffer %d bytes (%d lines)",
+             width, height, out_len, (esp_timer_get_time() - start_time) / 1000, block_size, block_lines);
 
     if (cb) {
-        cb(cb_arg, 0, outbuf, (size_t)out_len);
-        cb(cb_arg, 1, NULL, 0);  // 结束信号
+        if (out_len > sent) {
+            cb(cb_arg, chunk_index++, outbuf + sent, (size_t)(out_len - sent));
+        }
+        cb(cb_arg, chunk_index, NULL, 0);  // 结束信号
         free(outbuf);
         if (jpg_out)
             *jpg_out = NULL;
@@ -19,6 +19,12 @@ extern "C" {
 // 返回: 实际处理的字节数
 typedef size_t (*jpg_out_cb)(void *arg, size_t index, const void *data, size_t len);
 
+// 编码线程与发送线程之间通过队列传递的JPEG数据块，data 为 NULL 表示结束
+typedef struct {
+    uint8_t *data;
+    size_t len;
+} JpegChunk;
+
 /**
  * @brief 将图像格式高效转换为JPEG
  * 
@@ -31,7 +37,7 @@ typedef size_t (*jpg_out_cb)(void *arg, size_t index, const void *data, size_t l
  * @param src_len   源图像数据长度
  * @param width     图像宽度
  * @param height    图像高度  
- * @param format    图像格式 (PIXFORMAT_RGB565, PIXFORMAT_RGB888, 等)
+ * @param format    图像格式 (V4L2_PIX_FMT_RGB565, V4L2_PIX_FMT_RGB565X, V4L2_PIX_FMT_RGB24, 等)
  * @param quality   JPEG质量 (1-100)
  * @param out       输出JPEG数据指针 (需要调用者释放)
  * @param out_len   输出JPEG数据长度
@@ -46,8 +52,8 @@ bool image_to_jpeg(uint8_t *src, size_t src_len, uint16_t width, uint16_t height
  * 
  * 使用回调函数处理JPEG输出数据，适合流式传输或分块处理：
  * - 节省约8KB的SRAM使用（静态变量改为堆分配）
- * - 支持流式输出，无需预分配大缓冲区
- * - 通过回调函数逐块处理JPEG数据
+ * - 软件编码按 MCU 行（8/16 行）分块转换输入，无需整帧的转换缓冲区
+ * - 每编码一块即通过回调输出新增的JPEG数据，最后以 data 为 NULL 的回调结束
  * 
  * @param src       源图像数据
  * @param src_len   源图像数据长度
@@ -0,0 +1,189 @@
+#include "lvgl_animation.h"
+#include "gif/lvgl_gif.h"
+#include "anim/lvgl_rle_animation.h"
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <cstring>
+
+#define TAG "LvglAnimation"
+
+std::unique_ptr<LvglAnimation> LvglAnimation::Create(const lv_img_dsc_t* img_dsc) {
+    if (!img_dsc || !img_dsc->data || img_dsc->data_size < 4) {
+        ESP_LOGE(TAG, "Invalid image descriptor");
+        return nullptr;
+    }
+
+    std::unique_ptr<LvglAnimation> animation;
+    if (memcmp(img_dsc->data, "GIF", 3) == 0) {
+        animation = std::make_unique<LvglGif>(img_dsc);
+    } else if (memcmp(img_dsc->data, RLE_ANIMATION_MAGIC, 4) == 0) {
+        animation = std::make_unique<LvglRleAnimation>(img_dsc);
+    } else {
+        ESP_LOGE(TAG, "Unknown animation format");
+        return nullptr;
+    }
+    if (!animation->IsLoaded()) {
+        return nullptr;
+    }
+    return animation;
+}
+
+size_t LvglAnimation::EstimateSize(const lv_img_dsc_t* img_dsc) {
+    if (!img_dsc || !img_dsc->data || img_dsc->data_size < 4) {
+        return 0;
+    }
+    if (memcmp(img_dsc->data, "GIF", 3) == 0) {
+        return LvglGif::EstimateSize(img_dsc);
+    } else if (memcmp(img_dsc->data, RLE_ANIMATION_MAGIC, 4) == 0) {
+        return LvglRleAnimation::EstimateSize(img_dsc);
+    }
+    return 0;
+}
+
+LvglAnimation::~LvglAnimation() {
+    if (timer_) {
+        lv_timer_delete(timer_);
+        timer_ = nullptr;
+    }
+}
+
+const lv_img_dsc_t* LvglAnimation::image_dsc() const {
+    if (!loaded_) {
+        return nullptr;
+    }
+    return &img_dsc_;
+}
+
+// Animation control methods
+void LvglAnimation::Start() {
+    if (!loaded_) {
+        ESP_LOGW(TAG, "Animation not loaded, cannot start");
+        return;
+    }
+
+    if (!timer_) {
+        timer_ = lv_timer_create([](lv_timer_t* timer) {
+            auto animation = static_cast<LvglAnimation*>(lv_timer_get_user_data(timer));
+            animation->NextFrame();
+        }, 10, this);
+    }
+
+    if (timer_) {
+        playing_ = true;
+        last_call_ = lv_tick_get();
+        lv_timer_resume(timer_);
+        lv_timer_reset(timer_);
+
+        // A cached decoder still holds the last frame it showed, go back and render the first frame now
+        Rewind();
+        ShowNextFrame(true);
+
+        ESP_LOGD(TAG, "Animation started");
+    }
+}
+
+void LvglAnimation::Pause() {
+    if (timer_) {
+        playing_ = false;
+        lv_timer_pause(timer_);
+        ESP_LOGD(TAG, "Animation paused");
+    }
+}
+
+void LvglAnimation::Resume() {
+    if (!loaded_) {
+        ESP_LOGW(TAG, "Animation not loaded, cannot resume");
+        return;
+    }
+
+    if (timer_) {
+        playing_ = true;
+        lv_timer_resume(timer_);
+        ESP_LOGD(TAG, "Animation resumed");
+    }
+}
+
+void LvglAnimation::Stop() {
+    if (timer_) {
+        playing_ = false;
+        lv_timer_pause(timer_);
+    }
+
+    if (loaded_) {
+        Rewind();
+        ESP_LOGD(TAG, "Animation stopped and rewound");
+    }
+}
+
+bool LvglAnimation::IsPlaying() const {
+    return playing_;
+}
+
+bool LvglAnimation::IsLoaded() const {
+    return loaded_;
+}
+
+uint16_t LvglAnimation::width() const {
+    if (!loaded_) {
+        return 0;
+    }
+    return img_dsc_.header.w;
+}
+
+uint16_t LvglAnimation::height() const {
+    if (!loaded_) {
+        return 0;
+    }
+    return img_dsc_.header.h;
+}
+
+void LvglAnimation::SetFrameCallback(std::function<void()> callback) {
+    frame_callback_ = callback;
+}
+
+void LvglAnimation::TakeDecodeStatistics(uint32_t& frames, int64_t& time_us) {
+    frames += decoded_frames_;
+    time_us += decode_time_us_;
+    decoded_frames_ = 0;
+    decode_time_us_ = 0;
+}
+
+void LvglAnimation::NextFrame() {
+    if (!loaded_ || !playing_) {
+        return;
+    }
+
+    // Check if enough time has passed for the next frame
+    uint32_t elapsed = lv_tick_elaps(last_call_);
+    if (elapsed < FrameDelay()) {
+        return;
+    }
+
+    last_call_ = lv_tick_get();
+    ShowNextFrame(false);
+}
+
+void LvglAnimation::ShowNextFrame(bool whole_canvas) {
+    // Decode next frame
+    int64_t start_time = esp_timer_get_time();
+    int has_next = DecodeFrame(dirty_area_);
+    decode_time_us_ += esp_timer_get_time() - start_time;
+    decoded_frames_++;
+    if (whole_canvas) {
+        // The rewound canvas differs from the stale frame outside the first frame's rect too
+        lv_area_set(&dirty_area_, 0, 0, img_dsc_.header.w - 1, img_dsc_.header.h - 1);
+    }
+    if (has_next == 0) {
+        // Animation finished, pause timer
+        playing_ = false;
+        if (timer_) {
+            lv_timer_pause(timer_);
+        }
+        ESP_LOGD(TAG, "Animation completed");
+    }
+
+    // Call frame callback if set
+    if (frame_callback_) {
+        frame_callback_();
+    }
+}
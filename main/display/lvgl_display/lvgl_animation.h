@@ -0,0 +1,128 @@
+#pragma once
+
+#include <lvgl.h>
+#include <memory>
+#include <functional>
+
+/**
+ * Plays an animated image into an LVGL image descriptor. The frames are
+ * decoded by the subclasses, this class paces them with an LVGL timer.
+ */
+class LvglAnimation {
+public:
+    /**
+     * Open a GIF or RLE animation, depending on the magic of the data
+     */
+    static std::unique_ptr<LvglAnimation> Create(const lv_img_dsc_t* img_dsc);
+
+    /**
+     * Memory an opened animation needs, estimated from the header of the data
+     */
+    static size_t EstimateSize(const lv_img_dsc_t* img_dsc);
+
+    virtual ~LvglAnimation();
+
+    const lv_img_dsc_t* image_dsc() const;
+
+    /**
+     * Start/restart animation from the first frame, which is rendered right away
+     */
+    void Start();
+
+    /**
+     * Pause animation
+     */
+    void Pause();
+
+    /**
+     * Resume animation
+     */
+    void Resume();
+
+    /**
+     * Stop animation and rewind to first frame
+     */
+    void Stop();
+
+    /**
+     * Check if animation is currently playing
+     */
+    bool IsPlaying() const;
+
+    /**
+     * Check if animation was loaded successfully
+     */
+    bool IsLoaded() const;
+
+    /**
+     * Get animation dimensions
+     */
+    uint16_t width() const;
+    uint16_t height() const;
+
+    /**
+     * Set frame update callback
+     */
+    void SetFrameCallback(std::function<void()> callback);
+
+    /**
+     * Canvas area changed by the last frame, in image coordinates
+     */
+    const lv_area_t& dirty_area() const { return dirty_area_; }
+
+    /**
+     * Add the decoded frames and their decode time since the last call, then reset them
+     */
+    void TakeDecodeStatistics(uint32_t& frames, int64_t& time_us);
+
+protected:
+    // LVGL image descriptor of the canvas, set up by the subclass
+    lv_img_dsc_t img_dsc_ = {};
+    bool loaded_ = false;
+
+    /**
+     * Milliseconds to show the current frame
+     */
+    virtual uint32_t FrameDelay() const = 0;
+
+    /**
+     * Decode the next frame into the canvas and set the area it changed.
+     * Return 1 if got a frame, 0 if the animation finished, -1 on error.
+     */
+    virtual int DecodeFrame(lv_area_t& dirty_area) = 0;
+
+    /**
+     * Go back to the first frame
+     */
+    virtual void Rewind() = 0;
+
+private:
+    // Animation timer
+    lv_timer_t* timer_ = nullptr;
+
+    // Last frame update time
+    uint32_t last_call_ = 0;
+
+    // Animation state
+    bool playing_ = false;
+
+    // Frame update callback
+    std::function<void()> frame_callback_;
+
+    // Canvas area changed by the last frame
+    lv_area_t dirty_area_ = {};
+
+    // Decode statistics
+    uint32_t decoded_frames_ = 0;
+    int64_t decode_time_us_ = 0;
+
+    /**
+     * Update to next frame once the current one has been shown long enough
+     */
+    void NextFrame();
+
+    /**
+     * Decode the next frame and notify the frame callback
+     */
+    void ShowNextFrame(bool whole_canvas);
+};
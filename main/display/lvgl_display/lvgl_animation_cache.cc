@@ -0,0 +1,110 @@
+#include "lvgl_animation_cache.h"
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#define TAG "LvglAnimationCache"
+
+LvglAnimationCache::LvglAnimationCache(size_t budget) : budget_(budget) {
+}
+
+LvglAnimationCache::~LvglAnimationCache() {
+    Clear();
+}
+
+LvglAnimation* LvglAnimationCache::Get(const LvglImage* image) {
+    uses_[image]++;
+    auto it = Find(image);
+    if (it != entries_.end()) {
+        entries_.splice(entries_.begin(), entries_, it);
+        hits_++;
+        return it->animation.get();
+    }
+    misses_++;
+    return Open(image);
+}
+
+const LvglImage* LvglAnimationCache::NextPrewarm() {
+    const LvglImage* best = nullptr;
+    uint32_t best_uses = 0;
+    for (auto& [image, uses] : uses_) {
+        if (uses > best_uses && Find(image) == entries_.end() && used_ + LvglAnimation::EstimateSize(image->image_dsc()) <= budget_) {
+            best = image;
+            best_uses = uses;
+        }
+    }
+    return best;
+}
+
+void LvglAnimationCache::AddPrewarmed(const LvglImage* image, std::unique_ptr<LvglAnimation> animation, int64_t open_time_us) {
+    // Cleared caches forget the usage counts, the image may be gone
+    if (uses_.find(image) == uses_.end() || Find(image) != entries_.end()) {
+        return;
+    }
+    open_time_us_ += open_time_us;
+    if (!animation) {
+        // Do not try it again
+        uses_.erase(image);
+        return;
+    }
+    size_t size = LvglAnimation::EstimateSize(image->image_dsc());
+    if (used_ + size > budget_) {
+        return;
+    }
+    // Prewarmed decoders only take free budget and are the first to go
+    entries_.push_back({image, std::move(animation), size});
+    used_ += size;
+    prewarms_++;
+}
+
+void LvglAnimationCache::Clear() {
+    entries_.clear();
+    uses_.clear();
+    used_ = 0;
+}
+
+void LvglAnimationCache::PrintStatistics() {
+    uint32_t lookups = hits_ + misses_;
+    if (lookups == 0) {
+        return;
+    }
+    uint32_t opens = misses_ + prewarms_;
+    uint32_t frames = 0;
+    int64_t decode_time_us = 0;
+    for (auto& entry : entries_) {
+        entry.animation->TakeDecodeStatistics(frames, decode_time_us);
+    }
+    ESP_LOGI(TAG, "Animation cache: %u animations, %u/%u KB, hit rate %lu%% (%lu/%lu), prewarmed %lu, evicted %lu, open %lld us avg, decode %lld us/frame",
+        entries_.size(), used_ / 1024, budget_ / 1024, hits_ * 100 / lookups, hits_, lookups, prewarms_, evictions_,
+        opens > 0 ? open_time_us_ / opens : 0, frames > 0 ? decode_time_us / frames : 0);
+    hits_ = misses_ = prewarms_ = evictions_ = 0;
+    open_time_us_ = 0;
+}
+
+std::list<LvglAnimationCache::Entry>::iterator LvglAnimationCache::Find(const LvglImage* image) {
+    for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+        if (it->image == image) {
+            return it;
+        }
+    }
+    return entries_.end();
+}
+
+LvglAnimation* LvglAnimationCache::Open(const LvglImage* image) {
+    int64_t start_time = esp_timer_get_time();
+    auto animation = LvglAnimation::Create(image->image_dsc());
+    open_time_us_ += esp_timer_get_time() - start_time;
+    if (!animation) {
+        return nullptr;
+    }
+
+    size_t size = LvglAnimation::EstimateSize(image->image_dsc());
+    entries_.push_front({image, std::move(animation), size});
+    used_ += size;
+    // The one handed out is at the front and never closed
+    while (used_ > budget_ && entries_.size() > 1) {
+        used_ -= entries_.back().size;
+        entries_.pop_back();
+        evictions_++;
+    }
+    return entries_.front().animation.get();
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "lvgl_image.h"
+#include "lvgl_animation.h"
+#include <list>
+#include <memory>
+#include <unordered_map>
+
+/**
+ * LRU cache of opened animation decoders and their canvases, so switching back to an
+ * emoji does not reopen the animation and render it from scratch. The decoder in use
+ * is always kept, the least recently used ones are closed when over budget.
+ */
+class LvglAnimationCache {
+public:
+    explicit LvglAnimationCache(size_t budget);
+    ~LvglAnimationCache();
+
+    /**
+     * Get the decoder of an animated image, opening it when it is not cached.
+     * Returns nullptr if the animation can not be opened.
+     */
+    LvglAnimation* Get(const LvglImage* image);
+
+    /**
+     * The most used animation that is not cached and fits in the free budget, nullptr if none.
+     * It is opened by the caller, outside the LVGL task, and handed back with AddPrewarmed().
+     */
+    const LvglImage* NextPrewarm();
+
+    /**
+     * Add an animation opened for prewarming, dropped if the cache was cleared, the image got
+     * cached meanwhile or it no longer fits
+     */
+    void AddPrewarmed(const LvglImage* image, std::unique_ptr<LvglAnimation> animation, int64_t open_time_us);
+
+    /**
+     * Close all decoders and forget the usage counts, the images may be gone
+     */
+    void Clear();
+
+    void PrintStatistics();
+
+private:
+    struct Entry {
+        const LvglImage* image;
+        std::unique_ptr<LvglAnimation> animation;
+        size_t size;
+    };
+
+    size_t budget_;
+    size_t used_ = 0;
+    std::list<Entry> entries_;
+    // Times each image was shown, survives eviction to pick the animations worth prewarming
+    std::unordered_map<const LvglImage*, uint32_t> uses_;
+    uint32_t hits_ = 0;
+    uint32_t misses_ = 0;
+    uint32_t prewarms_ = 0;
+    uint32_t evictions_ = 0;
+    int64_t open_time_us_ = 0;
+
+    std::list<Entry>::iterator Find(const LvglImage* image);
+    LvglAnimation* Open(const LvglImage* image);
+};
@@ -3,15 +3,18 @@
 #include <string>
 #include <cstdlib>
 #include <cstring>
+#include <algorithm>
 #include <font_awesome.h>
 
 #include "lvgl_display.h"
+#include "lvgl_font.h"
 #include "board.h"
 #include "application.h"
 #include "audio_codec.h"
 #include "settings.h"
 #include "assets/lang_config.h"
 #include "jpg/image_to_jpeg.h"
+#include "trace_recorder.h"
 
 #define TAG "Display"
 
@@ -40,6 +43,54 @@ LvglDisplay::LvglDisplay() {
     }
 }
 
+void LvglDisplay::AddRenderEvents() {
+    render_statistics_ = {};
+    render_statistics_.start_time_us = esp_timer_get_time();
+    // Called from the LVGL task with the display lock held
+    lv_display_add_event_cb(display_, [](lv_event_t* e) {
+        auto& stats = static_cast<LvglDisplay*>(lv_event_get_user_data(e))->render_statistics_;
+        switch (lv_event_get_code(e)) {
+            case LV_EVENT_RENDER_START: {
+                TRACE_BEGIN(kTraceEventLvglRender);
+                stats.render_start_us = esp_timer_get_time();
+                break;
+            }
+            case LV_EVENT_RENDER_READY: {
+                TRACE_END(kTraceEventLvglRender);
+                int64_t render_time_us = esp_timer_get_time() - stats.render_start_us;
+                stats.frames++;
+                stats.render_time_us += render_time_us;
+                if (render_time_us > stats.max_render_time_us) {
+                    stats.max_render_time_us = render_time_us;
+                }
+                break;
+            }
+            case LV_EVENT_FLUSH_START: TRACE_BEGIN(kTraceEventLvglFlush); break;
+            case LV_EVENT_FLUSH_FINISH: TRACE_END(kTraceEventLvglFlush); break;
+            // LVGL waits here for the panel to finish the previous transfer before reusing a buffer
+            case LV_EVENT_FLUSH_WAIT_START: stats.flush_wait_start_us = esp_timer_get_time(); break;
+            case LV_EVENT_FLUSH_WAIT_FINISH: stats.flush_wait_time_us += esp_timer_get_time() - stats.flush_wait_start_us; break;
+            default: break;
+        }
+    }, LV_EVENT_ALL, this);
+}
+
+void LvglDisplay::PrintRenderStatistics() {
+    DisplayLockGuard lock(this);
+    auto& stats = render_statistics_;
+    if (display_ == nullptr || stats.frames == 0) {
+        return;
+    }
+    int64_t now = esp_timer_get_time();
+    int64_t elapsed_us = std::max<int64_t>(now - stats.start_time_us, 1);
+    ESP_LOGI(TAG, "Render: %lu frames, %.1f fps, render avg %lld us max %lld us, flush wait avg %lld us",
+        stats.frames, stats.frames * 1000000.0f / elapsed_us, stats.render_time_us / stats.frames,
+        stats.max_render_time_us, stats.flush_wait_time_us / stats.frames);
+    LvglCBinFont::PrintCacheStatistics();
+    stats = {};
+    stats.start_time_us = now;
+}
+
 LvglDisplay::~LvglDisplay() {
     if (notification_timer_ != nullptr) {
         esp_timer_stop(notification_timer_);
@@ -103,38 +154,15 @@ void LvglDisplay::UpdateStatusBar(bool update_all) {
     auto& board = Board::GetInstance();
     auto codec = board.GetAudioCodec();
 
-    // Update mute icon
     {
         DisplayLockGuard lock(this);
         if (mute_label_ == nullptr) {
             return;
         }
-
-        // 如果静音状态改变，则更新图标
-        if (codec->output_volume() == 0 && !muted_) {
-            muted_ = true;
-            lv_label_set_text(mute_label_, FONT_AWESOME_VOLUME_XMARK);
-        } else if (codec->output_volume() > 0 && muted_) {
-            muted_ = false;
-            lv_label_set_text(mute_label_, "");
-        }
     }
-
-    // Update time
-    if (app.GetDeviceState() == kDeviceStateIdle) {
-        if (last_status_update_time_ + std::chrono::seconds(10) < std::chrono::system_clock::now()) {
-            // Set status to clock "HH:MM"
-            time_t now = time(NULL);
-            struct tm* tm = localtime(&now);
-            // Check if the we have already set the time
-            if (tm->tm_year >= 2025 - 1900) {
-                char time_str[16];
-                strftime(time_str, sizeof(time_str), "%H:%M  ", tm);
-                SetStatus(time_str);
-            } else {
-                ESP_LOGW(TAG, "System time is not set, tm_year: %d", tm->tm_year);
-            }
-        }
+    // The mute icon follows SetMuted() from the codec, only the initial state is read here
+    if (update_all) {
+        SetMuted(codec->output_volume() == 0);
     }
 
     esp_pm_lock_acquire(pm_lock_);
@@ -156,52 +184,83 @@ void LvglDisplay::UpdateStatusBar(bool update_all) {
             };
             icon = levels[battery_level / 20];
         }
-        DisplayLockGuard lock(this);
-        if (battery_label_ != nullptr && battery_icon_ != icon) {
+        // Only touch the labels when the battery state has changed
+        if (battery_icon_ != icon || battery_discharging_ != discharging || update_all) {
+            DisplayLockGuard lock(this);
             battery_icon_ = icon;
-            lv_label_set_text(battery_label_, battery_icon_);
-        }
+            battery_discharging_ = discharging;
+            if (battery_label_ != nullptr) {
+                lv_label_set_text(battery_label_, battery_icon_);
+            }
 
-        if (low_battery_popup_ != nullptr) {
-            if (strcmp(icon, FONT_AWESOME_BATTERY_EMPTY) == 0 && discharging) {
-                if (lv_obj_has_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN)) { // 如果低电量提示框隐藏，则显示
-                    lv_obj_remove_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN);
-                    app.PlaySound(Lang::Sounds::OGG_LOW_BATTERY);
-                }
-            } else {
-                // Hide the low battery popup when the battery is not empty
-                if (!lv_obj_has_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN)) { // 如果低电量提示框显示，则隐藏
-                    lv_obj_add_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN);
+            if (low_battery_popup_ != nullptr) {
+                if (strcmp(icon, FONT_AWESOME_BATTERY_EMPTY) == 0 && discharging) {
+                    if (lv_obj_has_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN)) { // 如果低电量提示框隐藏，则显示
+                        lv_obj_remove_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN);
+                        app.PlaySound(Lang::Sounds::OGG_LOW_BATTERY);
+                    }
+                } else {
+                    // Hide the low battery popup when the battery is not empty
+                    if (!lv_obj_has_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN)) { // 如果低电量提示框显示，则隐藏
+                        lv_obj_add_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN);
+                    }
                 }
             }
         }
     }
 
-    // 每 10 秒更新一次网络图标
-    static int seconds_counter = 0;
-    if (update_all || seconds_counter++ % 10 == 0) {
-        // 升级固件时，不读取 4G 网络状态，避免占用 UART 资源
-        auto device_state = Application::GetInstance().GetDeviceState();
-        static const std::vector<DeviceState> allowed_states = {
-            kDeviceStateIdle,
-            kDeviceStateStarting,
-            kDeviceStateWifiConfiguring,
-            kDeviceStateListening,
-            kDeviceStateActivating,
-        };
-        if (std::find(allowed_states.begin(), allowed_states.end(), device_state) != allowed_states.end()) {
-            icon = board.GetNetworkStateIcon();
-            if (network_label_ != nullptr && icon != nullptr && network_icon_ != icon) {
-                DisplayLockGuard lock(this);
-                network_icon_ = icon;
-                lv_label_set_text(network_label_, network_icon_);
-            }
+    // 升级固件时，不读取 4G 网络状态，避免占用 UART 资源
+    auto device_state = app.GetDeviceState();
+    static const std::vector<DeviceState> allowed_states = {
+        kDeviceStateIdle,
+        kDeviceStateStarting,
+        kDeviceStateWifiConfiguring,
+        kDeviceStateListening,
+        kDeviceStateActivating,
+    };
+    if (std::find(allowed_states.begin(), allowed_states.end(), device_state) != allowed_states.end()) {
+        icon = board.GetNetworkStateIcon();
+        if (network_label_ != nullptr && icon != nullptr && network_icon_ != icon) {
+            DisplayLockGuard lock(this);
+            network_icon_ = icon;
+            lv_label_set_text(network_label_, network_icon_);
         }
     }
 
     esp_pm_lock_release(pm_lock_);
 }
 
+void LvglDisplay::SetMuted(bool muted) {
+    DisplayLockGuard lock(this);
+    // 如果静音状态改变，则更新图标
+    if (mute_label_ == nullptr || muted == muted_) {
+        return;
+    }
+    muted_ = muted;
+    lv_label_set_text(mute_label_, muted_ ? FONT_AWESOME_VOLUME_XMARK : "");
+}
+
+void LvglDisplay::UpdateClock() {
+    if (Application::GetInstance().GetDeviceState() != kDeviceStateIdle) {
+        return;
+    }
+    // Keep the status text set by others for at least 10 seconds
+    if (last_status_update_time_ + std::chrono::seconds(10) >= std::chrono::system_clock::now()) {
+        return;
+    }
+    // Set status to clock "HH:MM"
+    time_t now = time(NULL);
+    struct tm* tm = localtime(&now);
+    // Check if the we have already set the time
+    if (tm->tm_year >= 2025 - 1900) {
+        char time_str[16];
+        strftime(time_str, sizeof(time_str), "%H:%M  ", tm);
+        SetStatus(time_str);
+    } else {
+        ESP_LOGW(TAG, "System time is not set, tm_year: %d", tm->tm_year);
+    }
+}
+
 void LvglDisplay::SetPreviewImage(std::unique_ptr<LvglImage> image) {
 }
 
@@ -216,39 +275,51 @@ void LvglDisplay::SetPowerSaveMode(bool on) {
 }
 
 bool LvglDisplay::SnapshotToJpeg(std::string& jpeg_data, int quality) {
-#if CONFIG_LV_USE_SNAPSHOT
-    DisplayLockGuard lock(this);
+    // 清空输出字符串并使用回调版本，避免预分配大内存块
+    jpeg_data.clear();
+    return SnapshotToJpeg([&jpeg_data](const void* data, size_t len) {
+        jpeg_data.append(static_cast<const char*>(data), len);
+    }, quality);
+}
 
-    lv_obj_t* screen = lv_screen_active();
-    lv_draw_buf_t* draw_buffer = lv_snapshot_take(screen, LV_COLOR_FORMAT_RGB565);
+bool LvglDisplay::SnapshotToJpeg(std::function<void(const void* data, size_t len)> callback, int quality) {
+#if CONFIG_LV_USE_SNAPSHOT
+    lv_draw_buf_t* draw_buffer = nullptr;
+    {
+        DisplayLockGuard lock(this);
+        lv_obj_t* screen = lv_screen_active();
+        draw_buffer = lv_snapshot_take(screen, LV_COLOR_FORMAT_RGB565);
+    }
     if (draw_buffer == nullptr) {
         ESP_LOGE(TAG, "Failed to take snapshot, draw_buffer is nullptr");
         return false;
     }
 
-    // swap bytes
-    uint16_t* data = (uint16_t*)draw_buffer->data;
-    size_t pixel_count = draw_buffer->data_size / 2;
-    for (size_t i = 0; i < pixel_count; i++) {
-        data[i] = __builtin_bswap16(data[i]);
-    }
-
-    // 清空输出字符串并使用回调版本，避免预分配大内存块
-    jpeg_data.clear();
-
     // 🚀 使用回调版本的JPEG编码器，进一步节省内存
-    bool ret = image_to_jpeg_cb((uint8_t*)draw_buffer->data, draw_buffer->data_size, draw_buffer->header.w, draw_buffer->header.h, V4L2_PIX_FMT_RGB565, quality,
+    // The encoder reads the snapshot as byte swapped RGB565 and converts it one MCU row stripe at a time,
+    // so neither a swapped copy nor a full frame RGB888 buffer is needed
+    struct Output {
+        std::function<void(const void* data, size_t len)>& callback;
+        size_t size;
+    } output = {callback, 0};
+    int64_t start_time = esp_timer_get_time();
+    bool ret = image_to_jpeg_cb((uint8_t*)draw_buffer->data, draw_buffer->data_size, draw_buffer->header.w, draw_buffer->header.h, V4L2_PIX_FMT_RGB565X, quality,
         [](void *arg, size_t index, const void *data, size_t len) -> size_t {
-        std::string* output = static_cast<std::string*>(arg);
+        auto output = static_cast<Output*>(arg);
         if (data && len > 0) {
-            output->append(static_cast<const char*>(data), len);
+            output->callback(data, len);
+            output->size += len;
         }
         return len;
-    }, &jpeg_data);
+    }, &output);
     if (!ret) {
         ESP_LOGE(TAG, "Failed to convert image to JPEG");
+    } else {
+        ESP_LOGI(TAG, "Snapshot %dx%d encoded to %u bytes in %lld ms", (int)draw_buffer->header.w, (int)draw_buffer->header.h,
+            output.size, (esp_timer_get_time() - start_time) / 1000);
     }
 
+    DisplayLockGuard lock(this);
     lv_draw_buf_destroy(draw_buffer);
     return ret;
 #else
@@ -11,6 +11,7 @@
 
 #include <string>
 #include <chrono>
+#include <functional>
 
 class LvglDisplay : public Display {
 public:
@@ -22,8 +23,13 @@ public:
     virtual void ShowNotification(const std::string &notification, int duration_ms = 3000);
     virtual void SetPreviewImage(std::unique_ptr<LvglImage> image);
     virtual void UpdateStatusBar(bool update_all = false);
+    virtual void SetMuted(bool muted);
+    virtual void UpdateClock();
     virtual void SetPowerSaveMode(bool on);
     virtual bool SnapshotToJpeg(std::string& jpeg_data, int quality = 80);
+    // Pass the JPEG to the callback chunk by chunk while it is encoded, the display is only locked to take the snapshot
+    virtual bool SnapshotToJpeg(std::function<void(const void* data, size_t len)> callback, int quality = 80);
+    virtual void PrintRenderStatistics();
 
 protected:
     esp_pm_lock_handle_t pm_lock_ = nullptr;
@@ -40,10 +46,25 @@ protected:
     const char* battery_icon_ = nullptr;
     const char* network_icon_ = nullptr;
     bool muted_ = false;
+    bool battery_discharging_ = false;
 
     std::chrono::system_clock::time_point last_status_update_time_;
     esp_timer_handle_t notification_timer_ = nullptr;
 
+    struct RenderStatistics {
+        uint32_t frames;
+        int64_t render_time_us;
+        int64_t max_render_time_us;
+        int64_t flush_wait_time_us;
+        int64_t render_start_us;
+        int64_t flush_wait_start_us;
+        int64_t start_time_us;
+    };
+    RenderStatistics render_statistics_ = {};
+
+    // Count frames, render and flush wait time, and record them with the trace recorder
+    void AddRenderEvents();
+
     friend class DisplayLockGuard;
     virtual bool Lock(int timeout_ms = 0) = 0;
     virtual void Unlock() = 0;
@@ -1,13 +1,171 @@
 #include "lvgl_font.h"
+#include "tagged_heap.h"
 #include <cbin_font.h>
 
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <cstring>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+#define TAG "LvglFont"
+
+#if CONFIG_CBIN_FONT_GLYPH_CACHE_KB > 0
+// LRU cache of the A8 glyph bitmaps produced by the cbin fonts, shared by all fonts
+class GlyphCache {
+public:
+    static GlyphCache& GetInstance() {
+        static GlyphCache instance;
+        return instance;
+    }
+
+    bool Load(const lv_font_t* font, uint32_t glyph, lv_draw_buf_t* draw_buf) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = map_.find(Key(font, glyph));
+        if (it == map_.end()) {
+            misses_++;
+            return false;
+        }
+        auto& entry = *it->second;
+        if (entry.stride != draw_buf->header.stride || entry.size > draw_buf->data_size) {
+            misses_++;
+            return false;
+        }
+        memcpy(draw_buf->data, entry.data, entry.size);
+        entries_.splice(entries_.begin(), entries_, it->second);
+        hits_++;
+        return true;
+    }
+
+    void Store(const lv_font_t* font, uint32_t glyph, const lv_draw_buf_t* draw_buf) {
+        uint32_t size = draw_buf->header.stride * draw_buf->header.h;
+        if (size == 0 || size > budget_ / 8) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        uint64_t key = Key(font, glyph);
+        if (map_.find(key) != map_.end()) {
+            return;
+        }
+        while (used_ + size > budget_ && !entries_.empty()) {
+            Evict(std::prev(entries_.end()));
+        }
+        auto data = (uint8_t*)TaggedHeap::Malloc(kHeapTagDisplay, size, MALLOC_CAP_SPIRAM);
+        if (data == nullptr) {
+            return;
+        }
+        memcpy(data, draw_buf->data, size);
+        entries_.push_front({key, data, size, draw_buf->header.stride});
+        map_[key] = entries_.begin();
+        used_ += size;
+    }
+
+    void Purge(const lv_font_t* font) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto it = entries_.begin(); it != entries_.end();) {
+            auto next = std::next(it);
+            if ((it->key >> 32) == ((uintptr_t)font & 0xFFFFFFFF)) {
+                Evict(it);
+            }
+            it = next;
+        }
+    }
+
+    void PrintStatistics() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        uint32_t lookups = hits_ + misses_;
+        if (lookups == 0) {
+            return;
+        }
+        ESP_LOGI(TAG, "Glyph cache: %u glyphs, %lu/%lu bytes, hit rate %lu%% (%lu/%lu), evicted %lu",
+            entries_.size(), used_, budget_, hits_ * 100 / lookups, hits_, lookups, evictions_);
+        hits_ = misses_ = evictions_ = 0;
+    }
+
+private:
+    struct Entry {
+        uint64_t key;
+        uint8_t* data;
+        uint32_t size;
+        uint32_t stride;
+    };
+
+    std::mutex mutex_;
+    std::list<Entry> entries_;
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> map_;
+    uint32_t budget_ = CONFIG_CBIN_FONT_GLYPH_CACHE_KB * 1024;
+    uint32_t used_ = 0;
+    uint32_t hits_ = 0;
+    uint32_t misses_ = 0;
+    uint32_t evictions_ = 0;
+
+    static uint64_t Key(const lv_font_t* font, uint32_t glyph) {
+        return ((uint64_t)((uintptr_t)font & 0xFFFFFFFF) << 32) | glyph;
+    }
+
+    void Evict(std::list<Entry>::iterator it) {
+        used_ -= it->size;
+        TaggedHeap::Free(kHeapTagDisplay, it->data);
+        map_.erase(it->key);
+        entries_.erase(it);
+        evictions_++;
+    }
+};
+#endif
+
 
 LvglCBinFont::LvglCBinFont(void* data) {
     font_ = cbin_font_create(static_cast<uint8_t*>(data));
+    if (font_ == nullptr) {
+        return;
+    }
+    // Glyph lookups resolve to the copy, which hands the bitmaps to the cache
+    cached_font_.font = *font_;
+    cached_font_.source = font_;
+#if CONFIG_CBIN_FONT_GLYPH_CACHE_KB > 0
+    cached_font_.font.get_glyph_bitmap = GetCachedGlyphBitmap;
+#endif
 }
 
 LvglCBinFont::~LvglCBinFont() {
     if (font_ != nullptr) {
+#if CONFIG_CBIN_FONT_GLYPH_CACHE_KB > 0
+        GlyphCache::GetInstance().Purge(&cached_font_.font);
+#endif
         cbin_font_delete(font_);
     }
-}
\ No newline at end of file
+}
+
+const lv_font_t* LvglCBinFont::font() const {
+    return font_ != nullptr ? &cached_font_.font : nullptr;
+}
+
+const void* LvglCBinFont::GetCachedGlyphBitmap(lv_font_glyph_dsc_t* g_dsc, lv_draw_buf_t* draw_buf) {
+#if CONFIG_CBIN_FONT_GLYPH_CACHE_KB > 0
+    auto font = g_dsc->resolved_font;
+    auto source = reinterpret_cast<const CachedFont*>(font)->source;
+    uint32_t glyph = g_dsc->gid.index;
+    // Raw bitmaps point into the font data, only the expanded A8 bitmaps are cached
+    if (g_dsc->req_raw_bitmap || draw_buf == nullptr || glyph == 0) {
+        return source->get_glyph_bitmap(g_dsc, draw_buf);
+    }
+    auto& cache = GlyphCache::GetInstance();
+    if (cache.Load(font, glyph, draw_buf)) {
+        return draw_buf;
+    }
+    auto bitmap = source->get_glyph_bitmap(g_dsc, draw_buf);
+    if (bitmap == draw_buf) {
+        cache.Store(font, glyph, draw_buf);
+    }
+    return bitmap;
+#else
+    return nullptr;
+#endif
+}
+
+void LvglCBinFont::PrintCacheStatistics() {
+#if CONFIG_CBIN_FONT_GLYPH_CACHE_KB > 0
+    GlyphCache::GetInstance().PrintStatistics();
+#endif
+}
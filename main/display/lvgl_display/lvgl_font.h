@@ -20,12 +20,26 @@ private:
 };
 
 
+/*
+ * Font in the cbin format, read from the memory mapped assets partition.
+ * With CONFIG_CBIN_FONT_GLYPH_CACHE_KB the rendered glyph bitmaps are kept in an LRU cache
+ * in PSRAM, so drawing the same characters again does not go through the flash cache.
+ */
 class LvglCBinFont : public LvglFont {
 public:
     LvglCBinFont(void* data);
     virtual ~LvglCBinFont();
-    virtual const lv_font_t* font() const override { return font_; }
+    virtual const lv_font_t* font() const override;
+
+    static void PrintCacheStatistics();
 
 private:
     lv_font_t* font_;
+    // A copy of font_ that serves the bitmaps from the glyph cache, the lv_font_t must come first
+    struct CachedFont {
+        lv_font_t font;
+        const lv_font_t* source;
+    } cached_font_;
+
+    static const void* GetCachedGlyphBitmap(lv_font_glyph_dsc_t* g_dsc, lv_draw_buf_t* draw_buf);
 };
@@ -1,4 +1,6 @@
 #include "lvgl_image.h"
+#include "anim/lvgl_rle_animation.h"
+#include "tagged_heap.h"
 #include <cbin_font.h>
 
 #include <esp_log.h>
@@ -24,6 +26,10 @@ bool LvglRawImage::IsGif() const {
     return ptr[0] == 'G' && ptr[1] == 'I' && ptr[2] == 'F';
 }
 
+bool LvglRawImage::IsAnimation() const {
+    return IsGif() || (image_dsc_.data_size >= 4 && memcmp(image_dsc_.data, RLE_ANIMATION_MAGIC, 4) == 0);
+}
+
 LvglCBinImage::LvglCBinImage(void* data) {
     image_dsc_ = cbin_img_dsc_create(static_cast<uint8_t*>(data));
 }
@@ -58,7 +64,7 @@ LvglAllocatedImage::LvglAllocatedImage(void* data, size_t size, int width, int h
 
 LvglAllocatedImage::~LvglAllocatedImage() {
     if (image_dsc_.data) {
-        heap_caps_free((void*)image_dsc_.data);
+        TaggedHeap::Free(kHeapTagDisplay, (void*)image_dsc_.data);
         image_dsc_.data = nullptr;
     }
 }
\ No newline at end of file
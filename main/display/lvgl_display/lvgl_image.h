@@ -8,6 +8,8 @@ class LvglImage {
 public:
     virtual const lv_img_dsc_t* image_dsc() const = 0;
     virtual bool IsGif() const { return false; }
+    // GIF or pre-decoded RLE animation, played by LvglAnimation
+    virtual bool IsAnimation() const { return IsGif(); }
     virtual ~LvglImage() = default;
 };
 
@@ -17,6 +19,7 @@ public:
     LvglRawImage(void* data, size_t size);
     virtual const lv_img_dsc_t* image_dsc() const override { return &image_dsc_; }
     virtual bool IsGif() const;
+    virtual bool IsAnimation() const;
 
 private:
     lv_img_dsc_t image_dsc_;
@@ -0,0 +1,142 @@
+#include "json_arena.h"
+#include "tagged_heap.h"
+
+#include <cJSON.h>
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+
+#define TAG "JsonArena"
+
+#define JSON_ARENA_ALIGNMENT 8
+#define JSON_ARENA_MAX_TAGS 12
+
+#if CONFIG_USE_JSON_ARENA
+struct TagStatistics {
+    char tag[JSON_ARENA_TAG_LENGTH];
+    size_t peak_bytes;
+    uint32_t scopes;
+    uint32_t fallbacks;
+};
+
+static uint8_t* arena_buffer_ = nullptr;
+static size_t arena_used_ = 0;
+static size_t arena_scope_peak_ = 0;
+static uint32_t arena_scope_fallbacks_ = 0;
+static std::atomic<TaskHandle_t> arena_owner_ = nullptr;
+static TagStatistics tag_statistics_[JSON_ARENA_MAX_TAGS];
+#endif
+
+
+void JsonArena::InstallHooks() {
+#if CONFIG_USE_JSON_ARENA
+    cJSON_Hooks hooks = {
+        .malloc_fn = Allocate,
+        .free_fn = Free,
+    };
+    cJSON_InitHooks(&hooks);
+    ESP_LOGI(TAG, "Installed cJSON hooks, arena size %d", CONFIG_JSON_ARENA_SIZE);
+#endif
+}
+
+void* JsonArena::Allocate(size_t size) {
+#if CONFIG_USE_JSON_ARENA
+    if (arena_owner_.load(std::memory_order_relaxed) == xTaskGetCurrentTaskHandle()) {
+        size_t aligned = (size + JSON_ARENA_ALIGNMENT - 1) & ~(size_t)(JSON_ARENA_ALIGNMENT - 1);
+        if (arena_used_ + aligned <= CONFIG_JSON_ARENA_SIZE) {
+            void* ptr = arena_buffer_ + arena_used_;
+            arena_used_ += aligned;
+            if (arena_used_ > arena_scope_peak_) {
+                arena_scope_peak_ = arena_used_;
+            }
+            return ptr;
+        }
+        arena_scope_fallbacks_++;
+    }
+#endif
+    return malloc(size);
+}
+
+void JsonArena::Free(void* ptr) {
+#if CONFIG_USE_JSON_ARENA
+    // Arena memory is released all at once when the scope ends
+    auto p = static_cast<uint8_t*>(ptr);
+    if (arena_buffer_ != nullptr && p >= arena_buffer_ && p < arena_buffer_ + CONFIG_JSON_ARENA_SIZE) {
+        return;
+    }
+#endif
+    free(ptr);
+}
+
+bool JsonArena::Acquire() {
+#if CONFIG_USE_JSON_ARENA
+    TaskHandle_t expected = nullptr;
+    if (!arena_owner_.compare_exchange_strong(expected, xTaskGetCurrentTaskHandle())) {
+        // Busy in another task, or a nested scope in this task which keeps using the outer scope
+        return false;
+    }
+    if (arena_buffer_ == nullptr) {
+#if CONFIG_SPIRAM
+        arena_buffer_ = (uint8_t*)TaggedHeap::Malloc(kHeapTagProtocol, CONFIG_JSON_ARENA_SIZE, MALLOC_CAP_SPIRAM);
+#else
+        arena_buffer_ = (uint8_t*)TaggedHeap::Malloc(kHeapTagProtocol, CONFIG_JSON_ARENA_SIZE, MALLOC_CAP_8BIT);
+#endif
+        if (arena_buffer_ == nullptr) {
+            ESP_LOGE(TAG, "Failed to allocate arena");
+            arena_owner_.store(nullptr);
+            return false;
+        }
+    }
+    arena_used_ = 0;
+    arena_scope_peak_ = 0;
+    arena_scope_fallbacks_ = 0;
+    return true;
+#else
+    return false;
+#endif
+}
+
+void JsonArena::Release(const char* tag) {
+#if CONFIG_USE_JSON_ARENA
+    for (auto& stats : tag_statistics_) {
+        if (stats.scopes == 0) {
+            strncpy(stats.tag, tag, JSON_ARENA_TAG_LENGTH - 1);
+        } else if (strcmp(stats.tag, tag) != 0) {
+            continue;
+        }
+        stats.scopes++;
+        stats.fallbacks += arena_scope_fallbacks_;
+        if (arena_scope_peak_ > stats.peak_bytes) {
+            stats.peak_bytes = arena_scope_peak_;
+            ESP_LOGI(TAG, "New peak for %s: %u bytes", stats.tag, stats.peak_bytes);
+        }
+        break;
+    }
+    if (arena_scope_fallbacks_ > 0) {
+        ESP_LOGW(TAG, "Arena full in %s, %lu allocations fell back to heap", tag, arena_scope_fallbacks_);
+    }
+
+    arena_used_ = 0;
+    arena_owner_.store(nullptr);
+#endif
+}
+
+JsonArenaScope::JsonArenaScope(const char* tag) {
+    SetTag(tag);
+    owner_ = JsonArena::Acquire();
+}
+
+JsonArenaScope::~JsonArenaScope() {
+    if (owner_) {
+        JsonArena::Release(tag_);
+    }
+}
+
+void JsonArenaScope::SetTag(const char* tag) {
+    strncpy(tag_, tag, JSON_ARENA_TAG_LENGTH - 1);
+    tag_[JSON_ARENA_TAG_LENGTH - 1] = '\0';
+}
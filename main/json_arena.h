@@ -0,0 +1,42 @@
+#ifndef JSON_ARENA_H
+#define JSON_ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+
+#define JSON_ARENA_TAG_LENGTH 16
+
+/*
+ * Bump allocator for cJSON, used for one parse / build / serialize scope.
+ * The cJSON hooks are installed once at startup and route allocations of the task that
+ * currently owns the arena into it, every other task keeps using the heap.
+ * When the arena is busy or full, allocations fall back to the heap transparently.
+ * Nothing allocated inside a scope may be kept after the scope ends.
+ */
+class JsonArena {
+public:
+    static void InstallHooks();
+
+private:
+    friend class JsonArenaScope;
+
+    static void* Allocate(size_t size);
+    static void Free(void* ptr);
+    static bool Acquire();
+    static void Release(const char* tag);
+};
+
+class JsonArenaScope {
+public:
+    explicit JsonArenaScope(const char* tag);
+    ~JsonArenaScope();
+
+    // Refine the statistics tag once the message type is known, e.g. after parsing
+    void SetTag(const char* tag);
+
+private:
+    bool owner_ = false;
+    char tag_[JSON_ARENA_TAG_LENGTH];
+};
+
+#endif // JSON_ARENA_H
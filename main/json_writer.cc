@@ -0,0 +1,129 @@
+#include "json_writer.h"
+
+#include <cstdio>
+#include <cinttypes>
+#include <cmath>
+
+
+JsonWriter::JsonWriter(std::string& out, size_t reserve) : out_(out) {
+    if (reserve > 0) {
+        out_.reserve(out_.size() + reserve);
+    }
+}
+
+void JsonWriter::BeginValue() {
+    if (need_comma_) {
+        out_ += ',';
+    }
+    need_comma_ = true;
+}
+
+JsonWriter& JsonWriter::BeginObject() {
+    BeginValue();
+    out_ += '{';
+    need_comma_ = false;
+    return *this;
+}
+
+JsonWriter& JsonWriter::EndObject() {
+    out_ += '}';
+    need_comma_ = true;
+    return *this;
+}
+
+JsonWriter& JsonWriter::BeginArray() {
+    BeginValue();
+    out_ += '[';
+    need_comma_ = false;
+    return *this;
+}
+
+JsonWriter& JsonWriter::EndArray() {
+    out_ += ']';
+    need_comma_ = true;
+    return *this;
+}
+
+JsonWriter& JsonWriter::Key(std::string_view key) {
+    BeginValue();
+    out_ += '"';
+    AppendEscaped(key);
+    out_ += "\":";
+    // The value follows the key without a comma
+    need_comma_ = false;
+    return *this;
+}
+
+JsonWriter& JsonWriter::String(std::string_view value) {
+    BeginValue();
+    out_ += '"';
+    AppendEscaped(value);
+    out_ += '"';
+    return *this;
+}
+
+JsonWriter& JsonWriter::Int(int64_t value) {
+    BeginValue();
+    char buffer[24];
+    int len = snprintf(buffer, sizeof(buffer), "%" PRId64, value);
+    out_.append(buffer, len);
+    return *this;
+}
+
+JsonWriter& JsonWriter::Number(double value) {
+    if (!std::isfinite(value)) {
+        return Null();
+    }
+    BeginValue();
+    char buffer[32];
+    int len = snprintf(buffer, sizeof(buffer), "%.15g", value);
+    out_.append(buffer, len);
+    return *this;
+}
+
+JsonWriter& JsonWriter::Bool(bool value) {
+    BeginValue();
+    out_ += value ? "true" : "false";
+    return *this;
+}
+
+JsonWriter& JsonWriter::Null() {
+    BeginValue();
+    out_ += "null";
+    return *this;
+}
+
+JsonWriter& JsonWriter::Raw(std::string_view json) {
+    BeginValue();
+    out_ += json;
+    return *this;
+}
+
+void JsonWriter::AppendEscaped(std::string_view value) {
+    // Copy runs of plain characters at once, only the few special ones are escaped
+    size_t run_start = 0;
+    for (size_t i = 0; i < value.size(); i++) {
+        unsigned char c = value[i];
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+        out_.append(value.data() + run_start, i - run_start);
+        run_start = i + 1;
+        switch (c) {
+            case '"': out_ += "\\\""; break;
+            case '\\': out_ += "\\\\"; break;
+            case '\n': out_ += "\\n"; break;
+            case '\r': out_ += "\\r"; break;
+            case '\t': out_ += "\\t"; break;
+            case '\b': out_ += "\\b"; break;
+            case '\f': out_ += "\\f"; break;
+            default: {
+                char buffer[8];
+                snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+                out_ += buffer;
+                break;
+            }
+        }
+    }
+    out_.append(value.data() + run_start, value.size() - run_start);
+}
@@ -0,0 +1,41 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+
+/*
+ * Appends JSON to a caller owned string without building a DOM or temporary strings.
+ * Commas are inserted automatically, strings are escaped.
+ *
+ *   std::string json;
+ *   JsonWriter writer(json, 256);
+ *   writer.BeginObject().Key("volume").Int(70).Key("theme").String("dark").EndObject();
+ */
+class JsonWriter {
+public:
+    explicit JsonWriter(std::string& out, size_t reserve = 0);
+
+    JsonWriter& BeginObject();
+    JsonWriter& EndObject();
+    JsonWriter& BeginArray();
+    JsonWriter& EndArray();
+    JsonWriter& Key(std::string_view key);
+    JsonWriter& String(std::string_view value);
+    JsonWriter& Int(int64_t value);
+    JsonWriter& Number(double value);
+    JsonWriter& Bool(bool value);
+    JsonWriter& Null();
+    // Appends an already serialized JSON value as is
+    JsonWriter& Raw(std::string_view json);
+
+private:
+    std::string& out_;
+    bool need_comma_ = false;
+
+    void BeginValue();
+    void AppendEscaped(std::string_view value);
+};
+
+#endif // JSON_WRITER_H
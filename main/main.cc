@@ -9,6 +9,7 @@
 
 #include "application.h"
 #include "system_info.h"
+#include "json_arena.h"
 
 #define TAG "main"
 
@@ -26,6 +27,9 @@ extern "C" void app_main(void)
     }
     ESP_ERROR_CHECK(ret);
 
+    // Route cJSON allocations through the per-message arena
+    JsonArena::InstallHooks();
+
     // Launch the application
     auto& app = Application::GetInstance();
     app.Start();
@@ -6,17 +6,26 @@
 #include "mcp_server.h"
 #include <esp_log.h>
 #include <esp_app_desc.h>
+#include <esp_timer.h>
 #include <algorithm>
 #include <cstring>
+#include <thread>
 #include <esp_pthread.h>
+#include <freertos/queue.h>
 
 #include "application.h"
 #include "display.h"
 #include "oled_display.h"
 #include "board.h"
 #include "settings.h"
+#include "json_arena.h"
+#include "json_writer.h"
+#include "task_profiler.h"
+#include "tagged_heap.h"
+#include "trace_recorder.h"
 #include "lvgl_theme.h"
 #include "lvgl_display.h"
+#include "jpg/image_to_jpeg.h"
 
 #define TAG "MCP"
 
@@ -99,7 +108,7 @@ void McpServer::AddCommonTools() {
 
     auto camera = board.GetCamera();
     if (camera) {
-        AddTool("self.camera.take_photo",
+        AddLongRunningTool("self.camera.take_photo",
             "Take a photo and explain it. Use this tool after the user asks you to see something.\n"
             "Args:\n"
             "  `question`: The question that you want to ask about the photo.\n"
@@ -108,7 +117,8 @@ void McpServer::AddCommonTools() {
             PropertyList({
                 Property("question", kPropertyTypeString)
             }),
-            [camera](const PropertyList& properties) -> ReturnValue {
+            [this, camera](const PropertyList& properties) -> ReturnValue {
+                std::lock_guard<std::mutex> lock(camera_mutex_);
                 // Lower the priority to do the camera capture
                 TaskPriorityReset priority_reset(1);
 
@@ -123,6 +133,7 @@ void McpServer::AddCommonTools() {
 
     // Restore the original tools list to the end of the tools list
     tools_.insert(tools_.end(), original_tools.begin(), original_tools.end());
+    RebuildToolIndex();
 }
 
 void McpServer::AddUserOnlyTools() {
@@ -135,14 +146,22 @@ void McpServer::AddUserOnlyTools() {
             return board.GetSystemInfoJson();
         });
 
+#if CONFIG_USE_TASK_PROFILER
+    AddUserOnlyTool("self.system.get_profile",
+        "Get the CPU usage of each core and the CPU usage, core affinity and minimum free stack of each task, averaged over the recent sampling periods",
+        PropertyList(),
+        [this](const PropertyList& properties) -> ReturnValue {
+            return TaskProfiler::GetInstance().GetProfileJson();
+        });
+#endif
+
     AddUserOnlyTool("self.reboot", "Reboot the system",
         PropertyList(),
         [this](const PropertyList& properties) -> ReturnValue {
             auto& app = Application::GetInstance();
-            app.Schedule([&app]() {
+            // Leave time for the reply to be sent before rebooting
+            app.ScheduleAfter(1000, [&app]() {
                 ESP_LOGW(TAG, "User requested reboot");
-                vTaskDelay(pdMS_TO_TICKS(1000));
-
                 app.Reboot();
             });
             return true;
@@ -189,28 +208,81 @@ void McpServer::AddUserOnlyTools() {
             });
 
 #if CONFIG_LV_USE_SNAPSHOT
-        AddUserOnlyTool("self.screen.snapshot", "Snapshot the screen and upload it to a specific URL",
+        AddLongRunningTool("self.screen.snapshot", "Snapshot the screen and upload it to a specific URL",
             PropertyList({
                 Property("url", kPropertyTypeString),
                 Property("quality", kPropertyTypeInteger, 80, 1, 100)
             }),
-            [display](const PropertyList& properties) -> ReturnValue {
+            [this, display](const PropertyList& properties) -> ReturnValue {
                 auto url = properties["url"].value<std::string>();
                 auto quality = properties["quality"].value<int>();
+                int64_t start_time = esp_timer_get_time();
 
-                std::string jpeg_data;
-                if (!display->SnapshotToJpeg(jpeg_data, quality)) {
-                    throw std::runtime_error("Failed to snapshot screen");
+                // Like Esp32Camera::Explain, a thread encodes the JPEG into the queue while this task uploads it,
+                // 40 entries bound the chunks waiting for the network
+                QueueHandle_t jpeg_queue = xQueueCreate(40, sizeof(JpegChunk));
+                if (jpeg_queue == nullptr) {
+                    throw std::runtime_error("Failed to create JPEG queue");
                 }
 
-                ESP_LOGI(TAG, "Upload snapshot %u bytes to %s", jpeg_data.size(), url.c_str());
-                
+                // Rendering the snapshot needs more stack than the default pthread has
+                esp_pthread_cfg_t pthread_cfg = esp_pthread_get_default_config();
+                pthread_cfg.stack_size = MCP_SNAPSHOT_ENCODER_STACK_SIZE;
+                pthread_cfg.thread_name = "snapshot";
+                esp_pthread_set_cfg(&pthread_cfg);
+                bool encoded = false;
+                std::thread encoder_thread([display, quality, jpeg_queue, &encoded]() {
+                    bool chunk_lost = false;
+                    bool ok = display->SnapshotToJpeg([jpeg_queue, &chunk_lost](const void* data, size_t len) {
+                        JpegChunk chunk = {.data = (uint8_t*)TaggedHeap::Malloc(kHeapTagMcp, len, MALLOC_CAP_SPIRAM), .len = len};
+                        if (chunk.data == nullptr) {
+                            chunk.data = (uint8_t*)TaggedHeap::Malloc(kHeapTagMcp, len, MALLOC_CAP_8BIT);
+                        }
+                        if (chunk.data == nullptr) {
+                            chunk_lost = true;
+                            return;
+                        }
+                        memcpy(chunk.data, data, len);
+                        xQueueSend(jpeg_queue, &chunk, portMAX_DELAY);
+                    }, quality);
+                    encoded = ok && !chunk_lost;
+                    // The last chunk
+                    JpegChunk chunk = {.data = nullptr, .len = 0};
+                    xQueueSend(jpeg_queue, &chunk, portMAX_DELAY);
+                });
+                pthread_cfg = esp_pthread_get_default_config();
+                esp_pthread_set_cfg(&pthread_cfg);
+
+                // Receive the chunks until the last one, uploading them if the connection is open and the call is alive
+                auto receive_chunks = [this, jpeg_queue](Http* http) -> size_t {
+                    size_t total_sent = 0;
+                    JpegChunk chunk;
+                    while (xQueueReceive(jpeg_queue, &chunk, portMAX_DELAY) == pdPASS && chunk.data != nullptr) {
+                        if (http != nullptr && IsCallCancelled()) {
+                            http = nullptr;
+                        }
+                        if (http != nullptr) {
+                            http->Write((const char*)chunk.data, chunk.len);
+                            total_sent += chunk.len;
+                        }
+                        TaggedHeap::Free(kHeapTagMcp, chunk.data);
+                    }
+                    return total_sent;
+                };
+                auto finish_encoder = [&]() {
+                    encoder_thread.join();
+                    vQueueDelete(jpeg_queue);
+                };
+
                 // 构造multipart/form-data请求体
                 std::string boundary = "----ESP32_SCREEN_SNAPSHOT_BOUNDARY";
                 
                 auto http = Board::GetInstance().GetNetwork()->CreateHttp(3);
                 http->SetHeader("Content-Type", "multipart/form-data; boundary=" + boundary);
+                http->SetHeader("Transfer-Encoding", "chunked");
                 if (!http->Open("POST", url)) {
+                    receive_chunks(nullptr);
+                    finish_encoder();
                     throw std::runtime_error("Failed to open URL: " + url);
                 }
                 {
@@ -224,7 +296,17 @@ void McpServer::AddUserOnlyTools() {
                 }
 
                 // JPEG数据
-                http->Write((const char*)jpeg_data.data(), jpeg_data.size());
+                size_t total_sent = receive_chunks(http.get());
+                finish_encoder();
+                if (IsCallCancelled()) {
+                    http->Close();
+                    throw std::runtime_error("Snapshot upload cancelled");
+                }
+                if (!encoded) {
+                    http->Close();
+                    throw std::runtime_error("Failed to snapshot screen");
+                }
+                ReportProgress(1, 2);
 
                 {
                     // multipart尾部
@@ -239,11 +321,28 @@ void McpServer::AddUserOnlyTools() {
                 }
                 std::string result = http->ReadAll();
                 http->Close();
-                ESP_LOGI(TAG, "Snapshot screen result: %s", result.c_str());
+                ESP_LOGI(TAG, "Snapshot %u bytes uploaded to %s in %lld ms, result: %s", total_sent, url.c_str(),
+                    (esp_timer_get_time() - start_time) / 1000, result.c_str());
                 return true;
-            });
-        
-        AddUserOnlyTool("self.screen.preview_image", "Preview an image on the screen",
+            }, MCP_TOOL_DEFAULT_TIMEOUT_MS, true);
+
+        AddLongRunningTool("self.screen.get_snapshot", "Snapshot the screen and return it as a JPEG image",
+            PropertyList({
+                Property("quality", kPropertyTypeInteger, 80, 1, 100)
+            }),
+            [display](const PropertyList& properties) -> ReturnValue {
+                auto quality = properties["quality"].value<int>();
+                // The encoder output is base64 encoded straight into the reply, which becomes the transport frame
+                auto producer = [display, quality](const std::function<void(const void* data, size_t len)>& write) {
+                    return display->SnapshotToJpeg([&write](const void* data, size_t len) {
+                        write(data, len);
+                    }, quality);
+                };
+                // About 2 bits per pixel at the default quality, the payload grows if the guess is short
+                return new ImageContent("image/jpeg", producer, display->width() * display->height() / 4);
+            }, MCP_TOOL_DEFAULT_TIMEOUT_MS, true);
+
+        AddLongRunningTool("self.screen.preview_image", "Preview an image on the screen",
             PropertyList({
                 Property("url", kPropertyTypeString)
             }),
@@ -260,7 +359,7 @@ void McpServer::AddUserOnlyTools() {
                 }
 
                 size_t content_length = http->GetBodyLength();
-                char* data = (char*)heap_caps_malloc(content_length, MALLOC_CAP_8BIT);
+                char* data = (char*)TaggedHeap::Malloc(kHeapTagMcp, content_length, MALLOC_CAP_8BIT);
                 if (data == nullptr) {
                     throw std::runtime_error("Failed to allocate memory for image: " + url);
                 }
@@ -268,7 +367,7 @@ void McpServer::AddUserOnlyTools() {
                 while (total_read < content_length) {
                     int ret = http->Read(data + total_read, content_length - total_read);
                     if (ret < 0) {
-                        heap_caps_free(data);
+                        TaggedHeap::Free(kHeapTagMcp, data);
                         throw std::runtime_error("Failed to download image: " + url);
                     }
                     if (ret == 0) {
@@ -278,10 +377,11 @@ void McpServer::AddUserOnlyTools() {
                 }
                 http->Close();
 
+                TaggedHeap::Transfer(kHeapTagMcp, kHeapTagDisplay, data);
                 auto image = std::make_unique<LvglAllocatedImage>(data, content_length);
                 display->SetPreviewImage(std::move(image));
                 return true;
-            });
+            }, MCP_TOOL_DEFAULT_TIMEOUT_MS, true);
 #endif // CONFIG_LV_USE_SNAPSHOT
     }
 #endif // HAVE_LVGL
@@ -302,15 +402,78 @@ void McpServer::AddUserOnlyTools() {
     }
 }
 
+void ImageContent::WriteJson(std::string& payload) const {
+    payload += "{\"type\":\"image\",\"mimeType\":\"";
+    payload += mime_type_;
+    payload += "\",\"data\":\"";
+    size_t raw_size = producer_ ? size_hint_ : data_.size();
+    payload.reserve(payload.size() + (raw_size + 2) / 3 * 4 + 2);
+
+    auto encode = [&payload](const uint8_t* data, size_t len) {
+        size_t offset = payload.size();
+        size_t olen = 0;
+        // mbedtls also writes a NUL terminator
+        payload.resize(offset + (len + 2) / 3 * 4 + 1);
+        mbedtls_base64_encode((unsigned char*)&payload[offset], payload.size() - offset, &olen, data, len);
+        payload.resize(offset + olen);
+    };
+
+    // Only whole 3-byte groups are encoded, the remaining bytes are carried over to the next chunk
+    uint8_t carry[3];
+    size_t carry_len = 0;
+    auto write = [&](const void* data, size_t len) {
+        auto p = static_cast<const uint8_t*>(data);
+        while (carry_len > 0 && carry_len < 3 && len > 0) {
+            carry[carry_len++] = *p++;
+            len--;
+        }
+        if (carry_len == 3) {
+            encode(carry, 3);
+            carry_len = 0;
+        } else if (carry_len > 0) {
+            return;
+        }
+        size_t whole = len - len % 3;
+        if (whole > 0) {
+            encode(p, whole);
+        }
+        for (size_t i = whole; i < len; i++) {
+            carry[carry_len++] = p[i];
+        }
+    };
+
+    if (producer_) {
+        if (!producer_(write)) {
+            throw std::runtime_error("Failed to produce image");
+        }
+    } else {
+        write(data_.data(), data_.size());
+    }
+    if (carry_len > 0) {
+        encode(carry, carry_len);
+    }
+    payload += "\"}";
+}
+
 void McpServer::AddTool(McpTool* tool) {
     // Prevent adding duplicate tools
-    if (std::find_if(tools_.begin(), tools_.end(), [tool](const McpTool* t) { return t->name() == tool->name(); }) != tools_.end()) {
+    if (tool_index_.find(tool->name()) != tool_index_.end()) {
         ESP_LOGW(TAG, "Tool %s already added", tool->name().c_str());
         return;
     }
 
     ESP_LOGI(TAG, "Add tool: %s%s", tool->name().c_str(), tool->user_only() ? " [user]" : "");
+    tool_index_[tool->name()] = tools_.size();
     tools_.push_back(tool);
+    tool_json_cache_.clear();
+}
+
+void McpServer::RebuildToolIndex() {
+    tool_index_.clear();
+    for (size_t i = 0; i < tools_.size(); i++) {
+        tool_index_[tools_[i]->name()] = i;
+    }
+    tool_json_cache_.clear();
 }
 
 void McpServer::AddTool(const std::string& name, const std::string& description, const PropertyList& properties, std::function<ReturnValue(const PropertyList&)> callback) {
@@ -323,7 +486,16 @@ void McpServer::AddUserOnlyTool(const std::string& name, const std::string& desc
     AddTool(tool);
 }
 
+void McpServer::AddLongRunningTool(const std::string& name, const std::string& description, const PropertyList& properties, std::function<ReturnValue(const PropertyList&)> callback,
+    int timeout_ms, bool user_only) {
+    auto tool = new McpTool(name, description, properties, callback);
+    tool->set_user_only(user_only);
+    tool->set_long_running(timeout_ms);
+    AddTool(tool);
+}
+
 void McpServer::ParseMessage(const std::string& message) {
+    JsonArenaScope arena("mcp");
     cJSON* json = cJSON_Parse(message.c_str());
     if (json == nullptr) {
         ESP_LOGE(TAG, "Failed to parse MCP message: %s", message.c_str());
@@ -353,6 +525,80 @@ void McpServer::ParseCapabilities(const cJSON* capabilities) {
 }
 
 void McpServer::ParseMessage(const cJSON* json) {
+    if (cJSON_IsArray(json)) {
+        ParseBatch(json);
+    } else {
+        ParseRequest(json);
+    }
+}
+
+void McpServer::ParseBatch(const cJSON* batch) {
+    if (cJSON_GetArraySize(batch) == 0) {
+        // JSON-RPC answers an empty batch with a single error, not with an empty array
+        ESP_LOGE(TAG, "Empty batch");
+        std::string payload;
+        AppendInvalidRequest(payload);
+        Application::GetInstance().SendMcpMessage(std::move(payload));
+        return;
+    }
+
+    // Replies of the batch are collected and sent back as one JSON-RPC batch response
+    batch_ = std::make_shared<BatchResponse>();
+    batch_replies_.clear();
+    batch_task_ = xTaskGetCurrentTaskHandle();
+    cJSON* item;
+    cJSON_ArrayForEach(item, batch) {
+        if (cJSON_IsObject(item)) {
+            ParseRequest(item);
+        } else {
+            ESP_LOGE(TAG, "Invalid request in batch");
+            AppendInvalidRequest(batch_replies_);
+        }
+    }
+    batch_task_ = nullptr;
+    auto batch = std::move(batch_);
+
+    if (batch_calls_.empty()) {
+        AddBatchReplies(batch, std::move(batch_replies_));
+        batch_replies_.clear();
+        return;
+    }
+
+    // Main loop tools of the batch are called together, their results join the same response
+    Application::GetInstance().Schedule([batch, payload = std::move(batch_replies_), calls = std::move(batch_calls_)]() mutable {
+        for (auto& call : calls) {
+            AppendToolCall(payload, call.id, call.tool, call.arguments);
+        }
+        AddBatchReplies(batch, std::move(payload));
+    });
+    batch_replies_.clear();
+    batch_calls_.clear();
+}
+
+void McpServer::AddBatchReplies(const std::shared_ptr<BatchResponse>& batch, std::string&& replies) {
+    std::string payload;
+    {
+        std::lock_guard<std::mutex> lock(batch->mutex);
+        if (!replies.empty()) {
+            if (batch->payload.size() > 1) {
+                batch->payload += ',';
+            }
+            batch->payload += replies;
+        }
+        if (--batch->pending > 0) {
+            return;
+        }
+        // A batch of notifications only, or of cancelled calls, gets no response at all
+        if (batch->payload.size() == 1) {
+            return;
+        }
+        batch->payload += ']';
+        payload = std::move(batch->payload);
+    }
+    Application::GetInstance().SendMcpMessage(std::move(payload));
+}
+
+void McpServer::ParseRequest(const cJSON* json) {
     // Check JSONRPC version
     auto version = cJSON_GetObjectItem(json, "jsonrpc");
     if (version == nullptr || !cJSON_IsString(version) || strcmp(version->valuestring, "2.0") != 0) {
@@ -368,6 +614,14 @@ void McpServer::ParseMessage(const cJSON* json) {
     }
     
     auto method_str = std::string(method->valuestring);
+    if (method_str == "notifications/cancelled") {
+        auto params = cJSON_GetObjectItem(json, "params");
+        auto request_id = cJSON_GetObjectItem(params, "requestId");
+        if (cJSON_IsNumber(request_id)) {
+            CancelToolCall(request_id->valueint);
+        }
+        return;
+    }
     if (method_str.find("notifications") == 0) {
         return;
     }
@@ -430,64 +684,134 @@ void McpServer::ParseMessage(const cJSON* json) {
             ReplyError(id_int, "Invalid arguments");
             return;
         }
-        DoToolCall(id_int, std::string(tool_name->valuestring), tool_arguments);
+        std::string progress_token;
+        auto meta = cJSON_GetObjectItem(params, "_meta");
+        if (cJSON_IsObject(meta)) {
+            auto token = cJSON_GetObjectItem(meta, "progressToken");
+            if (cJSON_IsString(token) || cJSON_IsNumber(token)) {
+                char* token_str = cJSON_PrintUnformatted(token);
+                progress_token = token_str;
+                cJSON_free(token_str);
+            }
+        }
+        DoToolCall(id_int, std::string(tool_name->valuestring), tool_arguments, progress_token);
     } else {
         ESP_LOGE(TAG, "Method not implemented: %s", method_str.c_str());
         ReplyError(id_int, "Method not implemented: " + method_str);
     }
 }
 
-void McpServer::ReplyResult(int id, const std::string& result) {
-    std::string payload = "{\"jsonrpc\":\"2.0\",\"id\":";
-    payload += std::to_string(id) + ",\"result\":";
+void McpServer::BeginResult(std::string& payload, int id) {
+    if (!payload.empty() && payload.back() != '[') {
+        payload += ',';
+    }
+    // The object is left open, the caller appends the result value and the closing brace
+    JsonWriter writer(payload);
+    writer.BeginObject().Key("jsonrpc").String("2.0").Key("id").Int(id).Key("result");
+}
+
+void McpServer::AppendResult(std::string& payload, int id, const std::string& result) {
+    BeginResult(payload, id);
     payload += result;
-    payload += "}";
-    Application::GetInstance().SendMcpMessage(payload);
+    payload += '}';
+}
+
+void McpServer::AppendToolCall(std::string& payload, int id, McpTool* tool, const PropertyList& arguments) {
+    TRACE_SCOPE(kTraceEventMcpToolCall, id);
+    // The result is written in place, a failing tool leaves a partial result behind which is rolled back
+    size_t rollback_size = payload.size();
+    try {
+        BeginResult(payload, id);
+        tool->Call(arguments, payload);
+        payload += '}';
+    } catch (const std::exception& e) {
+        ESP_LOGE(TAG, "tools/call: %s", e.what());
+        payload.resize(rollback_size);
+        AppendError(payload, id, e.what());
+    }
+}
+
+void McpServer::AppendError(std::string& payload, int id, const std::string& message) {
+    if (!payload.empty() && payload.back() != '[') {
+        payload += ',';
+    }
+    JsonWriter writer(payload, message.size() + 64);
+    writer.BeginObject().Key("jsonrpc").String("2.0").Key("id").Int(id);
+    writer.Key("error").BeginObject().Key("message").String(message).EndObject();
+    writer.EndObject();
+}
+
+void McpServer::AppendInvalidRequest(std::string& payload) {
+    if (!payload.empty() && payload.back() != '[') {
+        payload += ',';
+    }
+    payload += "{\"jsonrpc\":\"2.0\",\"id\":null,\"error\":{\"code\":-32600,\"message\":\"Invalid Request\"}}";
+}
+
+void McpServer::ReplyResult(int id, const std::string& result) {
+    if (batch_task_ == xTaskGetCurrentTaskHandle()) {
+        AppendResult(batch_replies_, id, result);
+        return;
+    }
+    std::string payload;
+    payload.reserve(result.size() + 48);
+    AppendResult(payload, id, result);
+    Application::GetInstance().SendMcpMessage(std::move(payload));
 }
 
 void McpServer::ReplyError(int id, const std::string& message) {
-    std::string payload = "{\"jsonrpc\":\"2.0\",\"id\":";
-    payload += std::to_string(id);
-    payload += ",\"error\":{\"message\":\"";
-    payload += message;
-    payload += "\"}}";
-    Application::GetInstance().SendMcpMessage(payload);
+    if (batch_task_ == xTaskGetCurrentTaskHandle()) {
+        AppendError(batch_replies_, id, message);
+        return;
+    }
+    std::string payload;
+    AppendError(payload, id, message);
+    Application::GetInstance().SendMcpMessage(std::move(payload));
 }
 
 void McpServer::GetToolsList(int id, const std::string& cursor, bool list_user_only_tools) {
     const int max_payload_size = 8000;
     std::string json = "{\"tools\":[";
     
-    bool found_cursor = cursor.empty();
-    auto it = tools_.begin();
-    std::string next_cursor = "";
-    
-    while (it != tools_.end()) {
-        // 如果我们还没有找到起始位置，继续搜索
-        if (!found_cursor) {
-            if ((*it)->name() == cursor) {
-                found_cursor = true;
-            } else {
-                ++it;
-                continue;
-            }
+    if (tool_json_cache_.size() != tools_.size()) {
+        int64_t start_time = esp_timer_get_time();
+        tool_json_cache_.clear();
+        tool_json_cache_.reserve(tools_.size());
+        for (auto tool : tools_) {
+            tool_json_cache_.push_back(tool->to_json());
         }
+        ESP_LOGI(TAG, "Serialized %u tools in %lld us", tools_.size(), esp_timer_get_time() - start_time);
+    }
 
-        if (!list_user_only_tools && (*it)->user_only()) {
-            ++it;
+    // The cursor is the name of the first tool of the page
+    size_t index = 0;
+    if (!cursor.empty()) {
+        auto cursor_iter = tool_index_.find(cursor);
+        if (cursor_iter == tool_index_.end()) {
+            ESP_LOGE(TAG, "tools/list: Invalid cursor %s", cursor.c_str());
+            ReplyError(id, "Invalid cursor: " + cursor);
+            return;
+        }
+        index = cursor_iter->second;
+    }
+
+    std::string next_cursor = "";
+    json.reserve(max_payload_size);
+    for (; index < tools_.size(); index++) {
+        if (!list_user_only_tools && tools_[index]->user_only()) {
             continue;
         }
         
         // 添加tool前检查大小
-        std::string tool_json = (*it)->to_json() + ",";
-        if (json.length() + tool_json.length() + 30 > max_payload_size) {
+        const std::string& tool_json = tool_json_cache_[index];
+        if (json.length() + tool_json.length() + 31 > max_payload_size) {
             // 如果添加这个tool会超出大小限制，设置next_cursor并退出循环
-            next_cursor = (*it)->name();
+            next_cursor = tools_[index]->name();
             break;
         }
         
         json += tool_json;
-        ++it;
+        json += ',';
     }
     
     if (json.back() == ',') {
@@ -510,19 +834,16 @@ void McpServer::GetToolsList(int id, const std::string& cursor, bool list_user_o
     ReplyResult(id, json);
 }
 
-void McpServer::DoToolCall(int id, const std::string& tool_name, const cJSON* tool_arguments) {
-    auto tool_iter = std::find_if(tools_.begin(), tools_.end(), 
-                                 [&tool_name](const McpTool* tool) { 
-                                     return tool->name() == tool_name; 
-                                 });
-    
-    if (tool_iter == tools_.end()) {
+void McpServer::DoToolCall(int id, const std::string& tool_name, const cJSON* tool_arguments, const std::string& progress_token) {
+    auto tool_iter = tool_index_.find(tool_name);
+    if (tool_iter == tool_index_.end()) {
         ESP_LOGE(TAG, "tools/call: Unknown tool: %s", tool_name.c_str());
         ReplyError(id, "Unknown tool: " + tool_name);
         return;
     }
+    auto tool = tools_[tool_iter->second];
 
-    PropertyList arguments = (*tool_iter)->properties();
+    PropertyList arguments = tool->properties();
     try {
         for (auto& argument : arguments) {
             bool found = false;
@@ -552,14 +873,198 @@ void McpServer::DoToolCall(int id, const std::string& tool_name, const cJSON* to
         return;
     }
 
+    if (tool->long_running()) {
+        QueueToolCall(id, tool, std::move(arguments), progress_token);
+        return;
+    }
+
+    if (batch_task_ == xTaskGetCurrentTaskHandle()) {
+        batch_calls_.push_back({id, tool, std::move(arguments)});
+        return;
+    }
+
     // Use main thread to call the tool
     auto& app = Application::GetInstance();
-    app.Schedule([this, id, tool_iter, arguments = std::move(arguments)]() {
-        try {
-            ReplyResult(id, (*tool_iter)->Call(arguments));
-        } catch (const std::exception& e) {
-            ESP_LOGE(TAG, "tools/call: %s", e.what());
-            ReplyError(id, e.what());
-        }
+    app.Schedule([id, tool, arguments = std::move(arguments)]() {
+        std::string payload;
+        AppendToolCall(payload, id, tool, arguments);
+        Application::GetInstance().SendMcpMessage(std::move(payload));
     });
 }
+
+void McpServer::QueueToolCall(int id, McpTool* tool, PropertyList&& arguments, const std::string& progress_token) {
+    auto call = std::make_shared<ToolCall>();
+    call->id = id;
+    call->tool = tool;
+    call->arguments = std::move(arguments);
+    call->progress_token = progress_token;
+    call->deadline_us = esp_timer_get_time() + (int64_t)tool->timeout_ms() * 1000;
+
+    std::unique_lock<std::mutex> lock(calls_mutex_);
+    if (active_calls_.find(id) != active_calls_.end()) {
+        lock.unlock();
+        ESP_LOGE(TAG, "tools/call: Duplicate request id %d", id);
+        ReplyError(id, "Duplicate request id: " + std::to_string(id));
+        return;
+    }
+    if (batch_task_ == xTaskGetCurrentTaskHandle()) {
+        // The worker replies into the batch response, which waits for it
+        call->batch = batch_;
+        std::lock_guard<std::mutex> batch_lock(batch_->mutex);
+        batch_->pending++;
+    }
+    if (!workers_started_) {
+        workers_started_ = true;
+        // Lower priority than the main event loop, so slow tools never delay audio and UI work
+        for (int i = 0; i < CONFIG_MCP_TOOL_WORKER_COUNT; i++) {
+            xTaskCreate([](void* arg) {
+                ((McpServer*)arg)->ToolWorkerTask();
+                vTaskDelete(NULL);
+            }, "mcp_tool", CONFIG_MCP_TOOL_WORKER_STACK_SIZE, this, 2, nullptr);
+        }
+
+        esp_timer_create_args_t timer_args = {
+            .callback = [](void* arg) {
+                ((McpServer*)arg)->CheckToolCallTimeouts();
+            },
+            .arg = this,
+            .dispatch_method = ESP_TIMER_TASK,
+            .name = "mcp_tool_timeout",
+            .skip_unhandled_events = true,
+        };
+        esp_timer_create(&timer_args, &timeout_timer_);
+    }
+
+    if (active_calls_.empty()) {
+        esp_timer_start_periodic(timeout_timer_, 1000000);
+    }
+    active_calls_[id] = call;
+    pending_calls_.push_back(call);
+    calls_cv_.notify_one();
+    ESP_LOGI(TAG, "tools/call: Queued %s (id %d), %u pending", tool->name().c_str(), id, pending_calls_.size());
+}
+
+void McpServer::ToolWorkerTask() {
+    while (true) {
+        std::shared_ptr<ToolCall> call;
+        {
+            std::unique_lock<std::mutex> lock(calls_mutex_);
+            calls_cv_.wait(lock, [this]() { return !pending_calls_.empty(); });
+            call = std::move(pending_calls_.front());
+            pending_calls_.pop_front();
+            if (call->cancelled) {
+                continue;
+            }
+            call->worker = xTaskGetCurrentTaskHandle();
+            running_calls_.push_back(call);
+        }
+
+        std::string payload;
+        int64_t start_time = esp_timer_get_time();
+        AppendToolCall(payload, call->id, call->tool, call->arguments);
+
+        {
+            std::lock_guard<std::mutex> lock(calls_mutex_);
+            running_calls_.erase(std::find(running_calls_.begin(), running_calls_.end(), call));
+        }
+
+        // A cancelled or timed out call has already been answered (or must not be)
+        if (TakeToolCall(call->id) == nullptr) {
+            ESP_LOGW(TAG, "tools/call: Drop result of %s (id %d)", call->tool->name().c_str(), call->id);
+            continue;
+        }
+        ESP_LOGI(TAG, "tools/call: %s (id %d) finished in %lld ms, %u bytes", call->tool->name().c_str(), call->id,
+            (esp_timer_get_time() - start_time) / 1000, payload.size());
+        if (call->batch != nullptr) {
+            AddBatchReplies(call->batch, std::move(payload));
+        } else {
+            Application::GetInstance().SendMcpMessage(std::move(payload));
+        }
+    }
+}
+
+std::shared_ptr<McpServer::ToolCall> McpServer::TakeToolCall(int id) {
+    std::lock_guard<std::mutex> lock(calls_mutex_);
+    auto it = active_calls_.find(id);
+    if (it == active_calls_.end()) {
+        return nullptr;
+    }
+    auto call = std::move(it->second);
+    active_calls_.erase(it);
+    if (active_calls_.empty()) {
+        esp_timer_stop(timeout_timer_);
+    }
+    return call;
+}
+
+std::shared_ptr<McpServer::ToolCall> McpServer::GetCurrentToolCall() {
+    std::lock_guard<std::mutex> lock(calls_mutex_);
+    auto current_task = xTaskGetCurrentTaskHandle();
+    for (auto& call : running_calls_) {
+        if (call->worker == current_task) {
+            return call;
+        }
+    }
+    return nullptr;
+}
+
+void McpServer::CancelToolCall(int id) {
+    // Only long-running calls can be cancelled, main loop tools are too short to bother
+    auto call = TakeToolCall(id);
+    if (call != nullptr) {
+        call->cancelled = true;
+        ESP_LOGI(TAG, "tools/call: Cancelled %s (id %d)", call->tool->name().c_str(), id);
+        if (call->batch != nullptr) {
+            // Cancelled calls are not answered, the rest of the batch is no longer held back
+            AddBatchReplies(call->batch, std::string());
+        }
+    }
+}
+
+void McpServer::CheckToolCallTimeouts() {
+    std::vector<std::shared_ptr<ToolCall>> expired;
+    {
+        std::lock_guard<std::mutex> lock(calls_mutex_);
+        int64_t now = esp_timer_get_time();
+        for (auto it = active_calls_.begin(); it != active_calls_.end();) {
+            if (it->second->deadline_us <= now) {
+                it->second->cancelled = true;
+                expired.push_back(std::move(it->second));
+                it = active_calls_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        if (active_calls_.empty()) {
+            esp_timer_stop(timeout_timer_);
+        }
+    }
+
+    for (auto& call : expired) {
+        ESP_LOGW(TAG, "tools/call: %s (id %d) timed out", call->tool->name().c_str(), call->id);
+        if (call->batch != nullptr) {
+            std::string reply;
+            AppendError(reply, call->id, "Tool call timed out: " + call->tool->name());
+            AddBatchReplies(call->batch, std::move(reply));
+        } else {
+            ReplyError(call->id, "Tool call timed out: " + call->tool->name());
+        }
+    }
+}
+
+bool McpServer::IsCallCancelled() {
+    auto call = GetCurrentToolCall();
+    return call != nullptr && call->cancelled;
+}
+
+void McpServer::ReportProgress(int progress, int total) {
+    auto call = GetCurrentToolCall();
+    if (call == nullptr || call->progress_token.empty() || call->cancelled) {
+        return;
+    }
+    std::string payload = "{\"jsonrpc\":\"2.0\",\"method\":\"notifications/progress\",\"params\":{\"progressToken\":";
+    payload += call->progress_token;
+    payload += ",\"progress\":" + std::to_string(progress);
+    payload += ",\"total\":" + std::to_string(total) + "}}";
+    Application::GetInstance().SendMcpMessage(std::move(payload));
+}
@@ -4,45 +4,51 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include <functional>
 #include <variant>
 #include <optional>
 #include <stdexcept>
 #include <thread>
+#include <mutex>
+#include <deque>
+#include <memory>
+#include <atomic>
+#include <condition_variable>
 #include <mbedtls/base64.h>
 
 #include <cJSON.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#define MCP_TOOL_DEFAULT_TIMEOUT_MS 30000
+#define MCP_SNAPSHOT_ENCODER_STACK_SIZE (8 * 1024)
 
 class ImageContent {
+public:
+    // Calls write() with consecutive chunks of the raw image (e.g. from a JPEG encoder callback), returns false on failure
+    using Producer = std::function<bool(const std::function<void(const void* data, size_t len)>& write)>;
+
 private:
-    std::string encoded_data_;
     std::string mime_type_;
-
-    static std::string Base64Encode(const std::string& data) {
-        size_t dlen = 0, olen = 0;
-        mbedtls_base64_encode((unsigned char*)nullptr, 0, &dlen, (const unsigned char*)data.data(), data.size());
-        std::string result(dlen, 0);
-        mbedtls_base64_encode((unsigned char*)result.data(), result.size(), &olen, (const unsigned char*)data.data(), data.size());
-        return result;
-    }
+    std::string data_;
+    Producer producer_;
+    size_t size_hint_ = 0;
 
 public:
-    ImageContent(const std::string& mime_type, const std::string& data) {
-        mime_type_ = mime_type;
-        // base64 encode data
-        encoded_data_ = Base64Encode(data);
-    }
+    ImageContent(const std::string& mime_type, std::string data)
+        : mime_type_(mime_type), data_(std::move(data)) {}
+    ImageContent(const std::string& mime_type, Producer producer, size_t size_hint = 0)
+        : mime_type_(mime_type), producer_(producer), size_hint_(size_hint) {}
+
+    // The image is base64 encoded chunk by chunk straight into the payload, it is never held encoded elsewhere
+    void WriteJson(std::string& payload) const;
 
     std::string to_json() const {
-        cJSON *json = cJSON_CreateObject();
-        cJSON_AddStringToObject(json, "type", "image");
-        cJSON_AddStringToObject(json, "mimeType", mime_type_.c_str());
-        cJSON_AddStringToObject(json, "data", encoded_data_.c_str());
-        char* json_str = cJSON_PrintUnformatted(json);
-        std::string result(json_str);
-        cJSON_free(json_str);
-        cJSON_Delete(json);
-        return result;
+        std::string json;
+        WriteJson(json);
+        return json;
     }
 };
 
@@ -212,6 +218,7 @@ private:
     PropertyList properties_;
     std::function<ReturnValue(const PropertyList&)> callback_;
     bool user_only_ = false;
+    int timeout_ms_ = 0;
 
 public:
     McpTool(const std::string& name, 
@@ -224,10 +231,14 @@ public:
         callback_(callback) {}
 
     void set_user_only(bool user_only) { user_only_ = user_only; }
+    // Long-running tools are executed by the MCP worker pool instead of the main event loop
+    void set_long_running(int timeout_ms) { timeout_ms_ = timeout_ms; }
     inline const std::string& name() const { return name_; }
     inline const std::string& description() const { return description_; }
     inline const PropertyList& properties() const { return properties_; }
     inline bool user_only() const { return user_only_; }
+    inline bool long_running() const { return timeout_ms_ > 0; }
+    inline int timeout_ms() const { return timeout_ms_; }
 
     std::string to_json() const {
         std::vector<std::string> required = properties_.GetRequired();
@@ -269,45 +280,43 @@ public:
         return result;
     }
 
-    std::string Call(const PropertyList& properties) {
+    // Appends the result object of the call to payload
+    void Call(const PropertyList& properties, std::string& payload) {
         ReturnValue return_value = callback_(properties);
+        if (std::holds_alternative<ImageContent*>(return_value)) {
+            std::unique_ptr<ImageContent> image_content(std::get<ImageContent*>(return_value));
+            payload += "{\"content\":[";
+            image_content->WriteJson(payload);
+            payload += "],\"isError\":false}";
+            return;
+        }
+
         // 返回结果
         cJSON* result = cJSON_CreateObject();
         cJSON* content = cJSON_CreateArray();
-
-        if (std::holds_alternative<ImageContent*>(return_value)) {
-            auto image_content = std::get<ImageContent*>(return_value);
-            cJSON* image = cJSON_CreateObject();
-            cJSON_AddStringToObject(image, "type", "image");
-            cJSON_AddStringToObject(image, "image", image_content->to_json().c_str());
-            cJSON_AddItemToArray(content, image);
-            delete image_content;
-        } else {
-            cJSON* text = cJSON_CreateObject();
-            cJSON_AddStringToObject(text, "type", "text");
-            if (std::holds_alternative<std::string>(return_value)) {
-                cJSON_AddStringToObject(text, "text", std::get<std::string>(return_value).c_str());
-            } else if (std::holds_alternative<bool>(return_value)) {
-                cJSON_AddStringToObject(text, "text", std::get<bool>(return_value) ? "true" : "false");
-            } else if (std::holds_alternative<int>(return_value)) {
-                cJSON_AddStringToObject(text, "text", std::to_string(std::get<int>(return_value)).c_str());
-            } else if (std::holds_alternative<cJSON*>(return_value)) {
-                cJSON* json = std::get<cJSON*>(return_value);
-                char* json_str = cJSON_PrintUnformatted(json);
-                cJSON_AddStringToObject(text, "text", json_str);
-                cJSON_free(json_str);
-                cJSON_Delete(json);
-            }
-            cJSON_AddItemToArray(content, text);
+        cJSON* text = cJSON_CreateObject();
+        cJSON_AddStringToObject(text, "type", "text");
+        if (std::holds_alternative<std::string>(return_value)) {
+            cJSON_AddStringToObject(text, "text", std::get<std::string>(return_value).c_str());
+        } else if (std::holds_alternative<bool>(return_value)) {
+            cJSON_AddStringToObject(text, "text", std::get<bool>(return_value) ? "true" : "false");
+        } else if (std::holds_alternative<int>(return_value)) {
+            cJSON_AddStringToObject(text, "text", std::to_string(std::get<int>(return_value)).c_str());
+        } else if (std::holds_alternative<cJSON*>(return_value)) {
+            cJSON* json = std::get<cJSON*>(return_value);
+            char* json_str = cJSON_PrintUnformatted(json);
+            cJSON_AddStringToObject(text, "text", json_str);
+            cJSON_free(json_str);
+            cJSON_Delete(json);
         }
+        cJSON_AddItemToArray(content, text);
         cJSON_AddItemToObject(result, "content", content);
         cJSON_AddBoolToObject(result, "isError", false);
 
         auto json_str = cJSON_PrintUnformatted(result);
-        std::string result_str(json_str);
+        payload += json_str;
         cJSON_free(json_str);
         cJSON_Delete(result);
-        return result_str;
     }
 };
 
@@ -323,22 +332,91 @@ public:
     void AddTool(McpTool* tool);
     void AddTool(const std::string& name, const std::string& description, const PropertyList& properties, std::function<ReturnValue(const PropertyList&)> callback);
     void AddUserOnlyTool(const std::string& name, const std::string& description, const PropertyList& properties, std::function<ReturnValue(const PropertyList&)> callback);
+    void AddLongRunningTool(const std::string& name, const std::string& description, const PropertyList& properties, std::function<ReturnValue(const PropertyList&)> callback,
+        int timeout_ms = MCP_TOOL_DEFAULT_TIMEOUT_MS, bool user_only = false);
     void ParseMessage(const cJSON* json);
+
+    // Called by long-running tools from their worker task, cancelled or timed out calls should stop early
+    void ReportProgress(int progress, int total);
+    bool IsCallCancelled();
     void ParseMessage(const std::string& message);
 
 private:
+    // The response of a JSON-RPC batch, sent as one array once every part of the batch has replied
+    struct BatchResponse {
+        std::mutex mutex;
+        std::string payload = "[";
+        // The parsed requests and main loop tools count as one part, each worker pool call as another
+        int pending = 1;
+    };
+
+    struct ToolCall {
+        int id;
+        McpTool* tool;
+        PropertyList arguments;
+        std::string progress_token;
+        int64_t deadline_us;
+        TaskHandle_t worker = nullptr;
+        std::atomic<bool> cancelled = false;
+        // Set when the call came in a batch, its reply joins the batch response
+        std::shared_ptr<BatchResponse> batch;
+    };
+
+    struct BatchToolCall {
+        int id;
+        McpTool* tool;
+        PropertyList arguments;
+    };
+
     McpServer();
     ~McpServer();
 
     void ParseCapabilities(const cJSON* capabilities);
 
+    void ParseBatch(const cJSON* batch);
+    void ParseRequest(const cJSON* json);
+    static void BeginResult(std::string& payload, int id);
+    static void AppendResult(std::string& payload, int id, const std::string& result);
+    static void AppendToolCall(std::string& payload, int id, McpTool* tool, const PropertyList& arguments);
+    static void AppendError(std::string& payload, int id, const std::string& message);
+    static void AppendInvalidRequest(std::string& payload);
+    static void AddBatchReplies(const std::shared_ptr<BatchResponse>& batch, std::string&& replies);
     void ReplyResult(int id, const std::string& result);
     void ReplyError(int id, const std::string& message);
 
     void GetToolsList(int id, const std::string& cursor, bool list_user_only_tools);
-    void DoToolCall(int id, const std::string& tool_name, const cJSON* tool_arguments);
+    void DoToolCall(int id, const std::string& tool_name, const cJSON* tool_arguments, const std::string& progress_token);
+    void QueueToolCall(int id, McpTool* tool, PropertyList&& arguments, const std::string& progress_token);
+    std::shared_ptr<ToolCall> TakeToolCall(int id);
+    std::shared_ptr<ToolCall> GetCurrentToolCall();
+    void CancelToolCall(int id);
+    void CheckToolCallTimeouts();
+    void ToolWorkerTask();
+    void RebuildToolIndex();
 
     std::vector<McpTool*> tools_;
+    // Tool name -> position in tools_, used for tools/call dispatch and tools/list cursors
+    std::unordered_map<std::string, size_t> tool_index_;
+    // Serialized tools, built on the first tools/list and dropped whenever a tool is added
+    std::vector<std::string> tool_json_cache_;
+
+    // Long-running tool calls, pending and running ones stay in active_calls_ until their reply is decided
+    std::mutex calls_mutex_;
+    std::condition_variable calls_cv_;
+    std::deque<std::shared_ptr<ToolCall>> pending_calls_;
+    std::map<int, std::shared_ptr<ToolCall>> active_calls_;
+    std::vector<std::shared_ptr<ToolCall>> running_calls_;
+    esp_timer_handle_t timeout_timer_ = nullptr;
+    bool workers_started_ = false;
+    // The camera keeps a single frame and encoder thread, so photo calls run one at a time
+    std::mutex camera_mutex_;
+
+    // Set while a JSON-RPC batch is parsed, replies from that task are collected instead of sent.
+    // Workers and the timeout timer compare it against their own task, so it is atomic
+    std::atomic<TaskHandle_t> batch_task_ = nullptr;
+    std::shared_ptr<BatchResponse> batch_;
+    std::string batch_replies_;
+    std::vector<BatchToolCall> batch_calls_;
 };
 
 #endif // MCP_SERVER_H
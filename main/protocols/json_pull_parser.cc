@@ -0,0 +1,266 @@
+#include "json_pull_parser.h"
+
+
+bool JsonPullParser::Parse(const char* data, size_t length, JsonMessageFields& fields) {
+    pos_ = data;
+    end_ = data + length;
+    scratch_used_ = 0;
+    fields = JsonMessageFields();
+
+    SkipWhitespace();
+    if (!Consume('{')) {
+        return false;
+    }
+    SkipWhitespace();
+    if (Consume('}')) {
+        return true;
+    }
+
+    while (true) {
+        SkipWhitespace();
+        std::string_view key;
+        if (!ReadKey(key)) {
+            return false;
+        }
+        SkipWhitespace();
+        if (!Consume(':')) {
+            return false;
+        }
+        SkipWhitespace();
+
+        std::string_view* target = nullptr;
+        if (key == "type") {
+            target = &fields.type;
+        } else if (key == "state") {
+            target = &fields.state;
+        } else if (key == "text") {
+            target = &fields.text;
+        } else if (key == "emotion") {
+            target = &fields.emotion;
+        }
+
+        if (target != nullptr && pos_ < end_ && *pos_ == '"') {
+            if (!ReadString(*target)) {
+                return false;
+            }
+        } else if (!SkipValue()) {
+            return false;
+        }
+
+        SkipWhitespace();
+        if (Consume(',')) {
+            continue;
+        }
+        return Consume('}');
+    }
+}
+
+void JsonPullParser::SkipWhitespace() {
+    while (pos_ < end_ && (*pos_ == ' ' || *pos_ == '\t' || *pos_ == '\n' || *pos_ == '\r')) {
+        pos_++;
+    }
+}
+
+bool JsonPullParser::Consume(char c) {
+    if (pos_ < end_ && *pos_ == c) {
+        pos_++;
+        return true;
+    }
+    return false;
+}
+
+bool JsonPullParser::ReadKey(std::string_view& key) {
+    // Keys we care about are plain ASCII, so we compare the raw bytes without unescaping
+    if (!Consume('"')) {
+        return false;
+    }
+    const char* start = pos_;
+    while (pos_ < end_ && *pos_ != '"') {
+        if (*pos_ == '\\') {
+            pos_++;
+        }
+        pos_++;
+    }
+    if (pos_ >= end_) {
+        return false;
+    }
+    key = std::string_view(start, pos_ - start);
+    pos_++;
+    return true;
+}
+
+bool JsonPullParser::ReadString(std::string_view& value) {
+    if (!Consume('"')) {
+        return false;
+    }
+    size_t start = scratch_used_;
+    while (pos_ < end_) {
+        char c = *pos_++;
+        if (c == '"') {
+            if (scratch_used_ >= sizeof(scratch_)) {
+                return false;
+            }
+            value = std::string_view(scratch_ + start, scratch_used_ - start);
+            scratch_[scratch_used_++] = '\0';
+            return true;
+        }
+        if (c != '\\') {
+            if (scratch_used_ >= sizeof(scratch_)) {
+                return false;
+            }
+            scratch_[scratch_used_++] = c;
+            continue;
+        }
+
+        if (pos_ >= end_) {
+            return false;
+        }
+        char escaped = *pos_++;
+        char decoded;
+        switch (escaped) {
+            case '"': decoded = '"'; break;
+            case '\\': decoded = '\\'; break;
+            case '/': decoded = '/'; break;
+            case 'b': decoded = '\b'; break;
+            case 'f': decoded = '\f'; break;
+            case 'n': decoded = '\n'; break;
+            case 'r': decoded = '\r'; break;
+            case 't': decoded = '\t'; break;
+            case 'u': {
+                uint32_t code_point;
+                if (!ReadHex4(code_point)) {
+                    return false;
+                }
+                // Combine UTF-16 surrogate pairs
+                if (code_point >= 0xD800 && code_point <= 0xDBFF) {
+                    uint32_t low;
+                    if (end_ - pos_ < 6 || pos_[0] != '\\' || pos_[1] != 'u') {
+                        return false;
+                    }
+                    pos_ += 2;
+                    if (!ReadHex4(low) || low < 0xDC00 || low > 0xDFFF) {
+                        return false;
+                    }
+                    code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00);
+                }
+                if (!AppendUtf8(code_point)) {
+                    return false;
+                }
+                continue;
+            }
+            default:
+                return false;
+        }
+        if (scratch_used_ >= sizeof(scratch_)) {
+            return false;
+        }
+        scratch_[scratch_used_++] = decoded;
+    }
+    return false;
+}
+
+bool JsonPullParser::ReadHex4(uint32_t& value) {
+    if (end_ - pos_ < 4) {
+        return false;
+    }
+    value = 0;
+    for (int i = 0; i < 4; i++) {
+        char c = *pos_++;
+        value <<= 4;
+        if (c >= '0' && c <= '9') {
+            value |= c - '0';
+        } else if (c >= 'a' && c <= 'f') {
+            value |= c - 'a' + 10;
+        } else if (c >= 'A' && c <= 'F') {
+            value |= c - 'A' + 10;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool JsonPullParser::AppendUtf8(uint32_t code_point) {
+    char buffer[4];
+    size_t size;
+    if (code_point < 0x80) {
+        buffer[0] = code_point;
+        size = 1;
+    } else if (code_point < 0x800) {
+        buffer[0] = 0xC0 | (code_point >> 6);
+        buffer[1] = 0x80 | (code_point & 0x3F);
+        size = 2;
+    } else if (code_point < 0x10000) {
+        buffer[0] = 0xE0 | (code_point >> 12);
+        buffer[1] = 0x80 | ((code_point >> 6) & 0x3F);
+        buffer[2] = 0x80 | (code_point & 0x3F);
+        size = 3;
+    } else {
+        buffer[0] = 0xF0 | (code_point >> 18);
+        buffer[1] = 0x80 | ((code_point >> 12) & 0x3F);
+        buffer[2] = 0x80 | ((code_point >> 6) & 0x3F);
+        buffer[3] = 0x80 | (code_point & 0x3F);
+        size = 4;
+    }
+    if (scratch_used_ + size > sizeof(scratch_)) {
+        return false;
+    }
+    for (size_t i = 0; i < size; i++) {
+        scratch_[scratch_used_++] = buffer[i];
+    }
+    return true;
+}
+
+bool JsonPullParser::SkipString() {
+    if (!Consume('"')) {
+        return false;
+    }
+    while (pos_ < end_) {
+        char c = *pos_++;
+        if (c == '"') {
+            return true;
+        }
+        if (c == '\\') {
+            pos_++;
+        }
+    }
+    return false;
+}
+
+bool JsonPullParser::SkipValue() {
+    if (pos_ >= end_) {
+        return false;
+    }
+    if (*pos_ == '"') {
+        return SkipString();
+    }
+    if (*pos_ == '{' || *pos_ == '[') {
+        int depth = 0;
+        while (pos_ < end_) {
+            char c = *pos_;
+            if (c == '"') {
+                if (!SkipString()) {
+                    return false;
+                }
+                continue;
+            }
+            pos_++;
+            if (c == '{' || c == '[') {
+                depth++;
+            } else if (c == '}' || c == ']') {
+                if (--depth == 0) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    // Numbers, true, false and null
+    const char* start = pos_;
+    while (pos_ < end_ && *pos_ != ',' && *pos_ != '}' && *pos_ != ']' &&
+        *pos_ != ' ' && *pos_ != '\t' && *pos_ != '\n' && *pos_ != '\r') {
+        pos_++;
+    }
+    return pos_ > start;
+}
@@ -0,0 +1,47 @@
+#ifndef JSON_PULL_PARSER_H
+#define JSON_PULL_PARSER_H
+
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
+
+#define JSON_PULL_PARSER_SCRATCH_SIZE 2048
+
+/*
+ * Fields of the high frequency messages (tts / stt / llm).
+ * The views point into the parser scratch buffer and are NUL terminated,
+ * they are only valid until the next call to Parse.
+ */
+struct JsonMessageFields {
+    std::string_view type;
+    std::string_view state;
+    std::string_view text;
+    std::string_view emotion;
+};
+
+/*
+ * Extracts a few top level string fields from a JSON object without building a DOM.
+ * Other values are skipped, strings are unescaped into a fixed scratch buffer.
+ */
+class JsonPullParser {
+public:
+    // Returns false if the data is not a valid JSON object or the strings do not fit in the scratch buffer
+    bool Parse(const char* data, size_t length, JsonMessageFields& fields);
+
+private:
+    const char* pos_ = nullptr;
+    const char* end_ = nullptr;
+    size_t scratch_used_ = 0;
+    char scratch_[JSON_PULL_PARSER_SCRATCH_SIZE];
+
+    void SkipWhitespace();
+    bool Consume(char c);
+    bool ReadKey(std::string_view& key);
+    bool ReadString(std::string_view& value);
+    bool SkipString();
+    bool SkipValue();
+    bool AppendUtf8(uint32_t code_point);
+    bool ReadHex4(uint32_t& value);
+};
+
+#endif // JSON_PULL_PARSER_H
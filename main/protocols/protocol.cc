@@ -8,6 +8,10 @@ void Protocol::OnIncomingJson(std::function<void(const cJSON* root)> callback) {
     on_incoming_json_ = callback;
 }
 
+void Protocol::OnIncomingMessageFields(std::function<void(const JsonMessageFields& fields)> callback) {
+    on_incoming_message_fields_ = callback;
+}
+
 void Protocol::OnIncomingAudio(std::function<void(std::unique_ptr<AudioStreamPacket> packet)> callback) {
     on_incoming_audio_ = callback;
 }
@@ -39,6 +43,55 @@ void Protocol::SetError(const std::string& message) {
     }
 }
 
+static bool IsHighFrequencyMessage(std::string_view type) {
+    return type == "tts" || type == "stt" || type == "llm";
+}
+
+bool Protocol::DispatchMessageFields(const char* data, size_t length) {
+    if (on_incoming_message_fields_ == nullptr) {
+        return false;
+    }
+    JsonMessageFields fields;
+    if (!json_parser_.Parse(data, length, fields) || !IsHighFrequencyMessage(fields.type)) {
+        return false;
+    }
+    on_incoming_message_fields_(fields);
+    return true;
+}
+
+void Protocol::DispatchAudio(std::unique_ptr<AudioStreamPacket> packet) {
+    if (on_incoming_audio_ == nullptr) {
+        return;
+    }
+    // Held here until the decode queue has room, a stuck decoder shows up under the protocol tag
+    packet->payload_charge = HeapCharge(kHeapTagProtocol, packet->payload.data());
+    on_incoming_audio_(std::move(packet));
+}
+
+void Protocol::DispatchJson(const cJSON* root) {
+    auto type = cJSON_GetObjectItem(root, "type");
+    if (on_incoming_message_fields_ != nullptr && cJSON_IsString(type) && IsHighFrequencyMessage(type->valuestring)) {
+        // Fallback for messages the pull parser rejected, e.g. text longer than its scratch buffer
+        JsonMessageFields fields;
+        fields.type = type->valuestring;
+        auto state = cJSON_GetObjectItem(root, "state");
+        if (cJSON_IsString(state)) {
+            fields.state = state->valuestring;
+        }
+        auto text = cJSON_GetObjectItem(root, "text");
+        if (cJSON_IsString(text)) {
+            fields.text = text->valuestring;
+        }
+        auto emotion = cJSON_GetObjectItem(root, "emotion");
+        if (cJSON_IsString(emotion)) {
+            fields.emotion = emotion->valuestring;
+        }
+        on_incoming_message_fields_(fields);
+    } else if (on_incoming_json_ != nullptr) {
+        on_incoming_json_(root);
+    }
+}
+
 void Protocol::SendAbortSpeaking(AbortReason reason) {
     std::string message = "{\"session_id\":\"" + session_id_ + "\",\"type\":\"abort\"";
     if (reason == kAbortReasonWakeWordDetected) {
@@ -73,9 +126,13 @@ void Protocol::SendStopListening() {
     SendText(message);
 }
 
-void Protocol::SendMcpMessage(const std::string& payload) {
-    std::string message = "{\"session_id\":\"" + session_id_ + "\",\"type\":\"mcp\",\"payload\":" + payload + "}";
-    SendText(message);
+void Protocol::SendMcpMessage(std::string&& payload) {
+    // Wrap the payload in place, it is moved inside its own buffer instead of copied into a new one
+    std::string header = "{\"session_id\":\"" + session_id_ + "\",\"type\":\"mcp\",\"payload\":";
+    payload.reserve(header.size() + payload.size() + 1);
+    payload.insert(0, header);
+    payload += '}';
+    SendText(payload);
 }
 
 bool Protocol::IsTimeout() const {
@@ -7,11 +7,16 @@
 #include <chrono>
 #include <vector>
 
+#include "json_pull_parser.h"
+#include "tagged_heap.h"
+
 struct AudioStreamPacket {
     int sample_rate = 0;
     int frame_duration = 0;
     uint32_t timestamp = 0;
     std::vector<uint8_t> payload;
+    // The payload is accounted under the protocol while it is received, then under audio while it is queued
+    HeapCharge payload_charge = {};
 };
 
 struct BinaryProtocol2 {
@@ -57,6 +62,8 @@ public:
 
     void OnIncomingAudio(std::function<void(std::unique_ptr<AudioStreamPacket> packet)> callback);
     void OnIncomingJson(std::function<void(const cJSON* root)> callback);
+    // High frequency messages (tts / stt / llm) are delivered here without building a cJSON tree
+    void OnIncomingMessageFields(std::function<void(const JsonMessageFields& fields)> callback);
     void OnAudioChannelOpened(std::function<void()> callback);
     void OnAudioChannelClosed(std::function<void()> callback);
     void OnNetworkError(std::function<void(const std::string& message)> callback);
@@ -72,10 +79,12 @@ public:
     virtual void SendStartListening(ListeningMode mode);
     virtual void SendStopListening();
     virtual void SendAbortSpeaking(AbortReason reason);
-    virtual void SendMcpMessage(const std::string& message);
+    // The envelope is built around the payload buffer, which is consumed
+    virtual void SendMcpMessage(std::string&& payload);
 
 protected:
     std::function<void(const cJSON* root)> on_incoming_json_;
+    std::function<void(const JsonMessageFields& fields)> on_incoming_message_fields_;
     std::function<void(std::unique_ptr<AudioStreamPacket> packet)> on_incoming_audio_;
     std::function<void()> on_audio_channel_opened_;
     std::function<void()> on_audio_channel_closed_;
@@ -88,10 +97,15 @@ protected:
     bool error_occurred_ = false;
     std::string session_id_;
     std::chrono::time_point<std::chrono::steady_clock> last_incoming_time_;
+    JsonPullParser json_parser_;
 
     virtual bool SendText(const std::string& text) = 0;
     virtual void SetError(const std::string& message);
     virtual bool IsTimeout() const;
+    // Returns true if the message was a high frequency message and has been dispatched
+    bool DispatchMessageFields(const char* data, size_t length);
+    void DispatchJson(const cJSON* root);
+    void DispatchAudio(std::unique_ptr<AudioStreamPacket> packet);
 };
 
 #endif // PROTOCOL_H
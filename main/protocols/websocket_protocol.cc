@@ -3,8 +3,12 @@
 #include "system_info.h"
 #include "application.h"
 #include "settings.h"
+#include "json_arena.h"
+#include "trace_recorder.h"
+#include "tagged_heap.h"
 
 #include <cstring>
+#include <esp_heap_caps.h>
 #include <cJSON.h>
 #include <esp_log.h>
 #include <arpa/inet.h>
@@ -30,10 +34,13 @@ bool WebsocketProtocol::SendAudio(std::unique_ptr<AudioStreamPacket> packet) {
         return false;
     }
 
+    // The frame buffers are accounted under the protocol tag, the peak shows the largest frame in flight
     if (version_ == 2) {
-        std::string serialized;
-        serialized.resize(sizeof(BinaryProtocol2) + packet->payload.size());
-        auto bp2 = (BinaryProtocol2*)serialized.data();
+        size_t size = sizeof(BinaryProtocol2) + packet->payload.size();
+        auto bp2 = (BinaryProtocol2*)TaggedHeap::Malloc(kHeapTagProtocol, size, MALLOC_CAP_8BIT);
+        if (bp2 == nullptr) {
+            return false;
+        }
         bp2->version = htons(version_);
         bp2->type = 0;
         bp2->reserved = 0;
@@ -41,17 +48,23 @@ bool WebsocketProtocol::SendAudio(std::unique_ptr<AudioStreamPacket> packet) {
         bp2->payload_size = htonl(packet->payload.size());
         memcpy(bp2->payload, packet->payload.data(), packet->payload.size());
 
-        return websocket_->Send(serialized.data(), serialized.size(), true);
+        bool sent = websocket_->Send((const char*)bp2, size, true);
+        TaggedHeap::Free(kHeapTagProtocol, bp2);
+        return sent;
     } else if (version_ == 3) {
-        std::string serialized;
-        serialized.resize(sizeof(BinaryProtocol3) + packet->payload.size());
-        auto bp3 = (BinaryProtocol3*)serialized.data();
+        size_t size = sizeof(BinaryProtocol3) + packet->payload.size();
+        auto bp3 = (BinaryProtocol3*)TaggedHeap::Malloc(kHeapTagProtocol, size, MALLOC_CAP_8BIT);
+        if (bp3 == nullptr) {
+            return false;
+        }
         bp3->type = 0;
         bp3->reserved = 0;
         bp3->payload_size = htons(packet->payload.size());
         memcpy(bp3->payload, packet->payload.data(), packet->payload.size());
 
-        return websocket_->Send(serialized.data(), serialized.size(), true);
+        bool sent = websocket_->Send((const char*)bp3, size, true);
+        TaggedHeap::Free(kHeapTagProtocol, bp3);
+        return sent;
     } else {
         return websocket_->Send(packet->payload.data(), packet->payload.size(), true);
     }
@@ -76,10 +89,12 @@ bool WebsocketProtocol::IsAudioChannelOpened() const {
 }
 
 void WebsocketProtocol::CloseAudioChannel() {
+    TRACE_INSTANT(kTraceEventAudioChannelClose);
     websocket_.reset();
 }
 
 bool WebsocketProtocol::OpenAudioChannel() {
+    TRACE_SCOPE(kTraceEventAudioChannelOpen);
     Settings settings("websocket", false);
     std::string url = settings.GetString("url");
     std::string token = settings.GetString("token");
@@ -118,7 +133,7 @@ bool WebsocketProtocol::OpenAudioChannel() {
                     bp2->timestamp = ntohl(bp2->timestamp);
                     bp2->payload_size = ntohl(bp2->payload_size);
                     auto payload = (uint8_t*)bp2->payload;
-                    on_incoming_audio_(std::make_unique<AudioStreamPacket>(AudioStreamPacket{
+                    DispatchAudio(std::make_unique<AudioStreamPacket>(AudioStreamPacket{
                         .sample_rate = server_sample_rate_,
                         .frame_duration = server_frame_duration_,
                         .timestamp = bp2->timestamp,
@@ -129,14 +144,14 @@ bool WebsocketProtocol::OpenAudioChannel() {
                     bp3->type = bp3->type;
                     bp3->payload_size = ntohs(bp3->payload_size);
                     auto payload = (uint8_t*)bp3->payload;
-                    on_incoming_audio_(std::make_unique<AudioStreamPacket>(AudioStreamPacket{
+                    DispatchAudio(std::make_unique<AudioStreamPacket>(AudioStreamPacket{
                         .sample_rate = server_sample_rate_,
                         .frame_duration = server_frame_duration_,
                         .timestamp = 0,
                         .payload = std::vector<uint8_t>(payload, payload + bp3->payload_size)
                     }));
                 } else {
-                    on_incoming_audio_(std::make_unique<AudioStreamPacket>(AudioStreamPacket{
+                    DispatchAudio(std::make_unique<AudioStreamPacket>(AudioStreamPacket{
                         .sample_rate = server_sample_rate_,
                         .frame_duration = server_frame_duration_,
                         .timestamp = 0,
@@ -144,17 +159,17 @@ bool WebsocketProtocol::OpenAudioChannel() {
                     }));
                 }
             }
-        } else {
+        } else if (!DispatchMessageFields(data, len)) {
             // Parse JSON data
+            JsonArenaScope arena("websocket");
             auto root = cJSON_Parse(data);
             auto type = cJSON_GetObjectItem(root, "type");
             if (cJSON_IsString(type)) {
+                arena.SetTag(type->valuestring);
                 if (strcmp(type->valuestring, "hello") == 0) {
                     ParseServerHello(root);
                 } else {
-                    if (on_incoming_json_ != nullptr) {
-                        on_incoming_json_(root);
-                    }
+                    DispatchJson(root);
                 }
             } else {
                 ESP_LOGE(TAG, "Missing message type, data: %s", data);
@@ -201,6 +216,7 @@ bool WebsocketProtocol::OpenAudioChannel() {
 
 std::string WebsocketProtocol::GetHelloMessage() {
     // keys: message type, version, audio_params (format, sample_rate, channels)
+    JsonArenaScope arena("hello");
     cJSON* root = cJSON_CreateObject();
     cJSON_AddStringToObject(root, "type", "hello");
     cJSON_AddNumberToObject(root, "version", version_);
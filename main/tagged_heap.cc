@@ -0,0 +1,135 @@
+#include "tagged_heap.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <atomic>
+
+#define TAG "TaggedHeap"
+
+#if CONFIG_USE_HEAP_TAGS
+struct HeapTagStatistics {
+    std::atomic<size_t> current_bytes;
+    std::atomic<size_t> peak_bytes;
+    std::atomic<uint32_t> blocks;
+};
+
+static const char* const kHeapTagNames[kHeapTagCount] = {
+    "audio",
+    "display",
+    "protocol",
+    "camera",
+    "mcp",
+};
+
+static HeapTagStatistics heap_tag_statistics_[kHeapTagCount];
+#endif
+
+
+void* TaggedHeap::Malloc(HeapTag tag, size_t size, uint32_t caps) {
+    void* ptr = heap_caps_malloc(size, caps);
+    Account(tag, ptr);
+    return ptr;
+}
+
+void* TaggedHeap::AlignedAlloc(HeapTag tag, size_t alignment, size_t size, uint32_t caps) {
+    void* ptr = heap_caps_aligned_alloc(alignment, size, caps);
+    Account(tag, ptr);
+    return ptr;
+}
+
+void TaggedHeap::Free(HeapTag tag, void* ptr) {
+    Release(tag, ptr);
+    heap_caps_free(ptr);
+}
+
+void TaggedHeap::Transfer(HeapTag from, HeapTag to, void* ptr) {
+    if (from != to) {
+        Release(from, ptr);
+        Account(to, ptr);
+    }
+}
+
+void TaggedHeap::Account(HeapTag tag, void* ptr) {
+#if CONFIG_USE_HEAP_TAGS
+    if (ptr == nullptr) {
+        return;
+    }
+    AccountSize(tag, heap_caps_get_allocated_size(ptr));
+#endif
+}
+
+void TaggedHeap::AccountSize(HeapTag tag, size_t size) {
+#if CONFIG_USE_HEAP_TAGS
+    auto& stats = heap_tag_statistics_[tag];
+    size_t current = stats.current_bytes.fetch_add(size, std::memory_order_relaxed) + size;
+    stats.blocks.fetch_add(1, std::memory_order_relaxed);
+    size_t peak = stats.peak_bytes.load(std::memory_order_relaxed);
+    while (current > peak && !stats.peak_bytes.compare_exchange_weak(peak, current, std::memory_order_relaxed)) {
+    }
+#endif
+}
+
+void TaggedHeap::Release(HeapTag tag, void* ptr) {
+#if CONFIG_USE_HEAP_TAGS
+    if (ptr == nullptr) {
+        return;
+    }
+    ReleaseSize(tag, heap_caps_get_allocated_size(ptr));
+#endif
+}
+
+void TaggedHeap::ReleaseSize(HeapTag tag, size_t size) {
+#if CONFIG_USE_HEAP_TAGS
+    auto& stats = heap_tag_statistics_[tag];
+    stats.current_bytes.fetch_sub(size, std::memory_order_relaxed);
+    stats.blocks.fetch_sub(1, std::memory_order_relaxed);
+#endif
+}
+
+HeapCharge::HeapCharge(HeapTag tag, const void* ptr) {
+#if CONFIG_USE_HEAP_TAGS
+    if (ptr == nullptr) {
+        return;
+    }
+    tag_ = tag;
+    size_ = heap_caps_get_allocated_size(const_cast<void*>(ptr));
+    TaggedHeap::AccountSize(tag_, size_);
+#endif
+}
+
+HeapCharge::HeapCharge(HeapCharge&& other) noexcept : tag_(other.tag_), size_(other.size_) {
+    other.tag_ = kHeapTagCount;
+    other.size_ = 0;
+}
+
+HeapCharge& HeapCharge::operator=(HeapCharge&& other) noexcept {
+    if (this != &other) {
+        Reset();
+        tag_ = other.tag_;
+        size_ = other.size_;
+        other.tag_ = kHeapTagCount;
+        other.size_ = 0;
+    }
+    return *this;
+}
+
+void HeapCharge::Reset() {
+    if (tag_ != kHeapTagCount) {
+        TaggedHeap::ReleaseSize(tag_, size_);
+        tag_ = kHeapTagCount;
+        size_ = 0;
+    }
+}
+
+void TaggedHeap::PrintStats() {
+#if CONFIG_USE_HEAP_TAGS
+    for (int i = 0; i < kHeapTagCount; i++) {
+        auto& stats = heap_tag_statistics_[i];
+        if (stats.peak_bytes.load() == 0) {
+            continue;
+        }
+        ESP_LOGI(TAG, "%s: %u bytes in %lu blocks, peak %u bytes", kHeapTagNames[i],
+            stats.current_bytes.load(), stats.blocks.load(), stats.peak_bytes.load());
+    }
+#endif
+}
@@ -0,0 +1,63 @@
+#ifndef TAGGED_HEAP_H
+#define TAGGED_HEAP_H
+
+#include <cstddef>
+#include <cstdint>
+
+enum HeapTag {
+    kHeapTagAudio,
+    kHeapTagDisplay,
+    kHeapTagProtocol,
+    kHeapTagCamera,
+    kHeapTagMcp,
+    kHeapTagCount
+};
+
+/*
+ * heap_caps allocation wrappers that account the buffers owned by each subsystem.
+ * The block size comes from the heap itself, so accounting costs a few atomic operations
+ * and no extra memory. A buffer must be freed with the tag it is accounted under,
+ * use Transfer() when the ownership moves to another subsystem.
+ */
+class TaggedHeap {
+public:
+    static void* Malloc(HeapTag tag, size_t size, uint32_t caps);
+    static void* AlignedAlloc(HeapTag tag, size_t alignment, size_t size, uint32_t caps);
+    static void Free(HeapTag tag, void* ptr);
+    static void Transfer(HeapTag from, HeapTag to, void* ptr);
+
+    static void PrintStats();
+
+private:
+    friend class HeapCharge;
+
+    static void Account(HeapTag tag, void* ptr);
+    static void Release(HeapTag tag, void* ptr);
+    static void AccountSize(HeapTag tag, size_t size);
+    static void ReleaseSize(HeapTag tag, size_t size);
+};
+
+/*
+ * Accounts a block that a std container allocated, e.g. the payload of an audio packet.
+ * The size is read when the charge is made and given back when the charge is dropped,
+ * so the container may be moved from or reallocated meanwhile. Assigning a new charge
+ * drops the previous one, which moves the block to another tag.
+ */
+class HeapCharge {
+public:
+    HeapCharge() = default;
+    HeapCharge(HeapTag tag, const void* ptr);
+    HeapCharge(HeapCharge&& other) noexcept;
+    HeapCharge& operator=(HeapCharge&& other) noexcept;
+    HeapCharge(const HeapCharge&) = delete;
+    HeapCharge& operator=(const HeapCharge&) = delete;
+    ~HeapCharge() { Reset(); }
+
+    void Reset();
+
+private:
+    HeapTag tag_ = kHeapTagCount;
+    size_t size_ = 0;
+};
+
+#endif // TAGGED_HEAP_H
@@ -0,0 +1,179 @@
+#include "task_profiler.h"
+#include "json_writer.h"
+#include "audio/processors/audio_debugger.h"
+
+#include <esp_log.h>
+#include <cstring>
+#include <algorithm>
+
+#define TAG "TaskProfiler"
+
+// Extra room for tasks created between counting and sampling
+#define TASK_STATUS_ARRAY_OFFSET 5
+
+
+TaskProfiler::TaskProfiler() {
+}
+
+TaskProfiler::~TaskProfiler() {
+}
+
+void TaskProfiler::Start(uint32_t period_ms) {
+    if (task_handle_ != nullptr) {
+        return;
+    }
+    period_ms_ = period_ms;
+    profiles_.reserve(TASK_PROFILER_MAX_TASKS);
+#if CONFIG_TASK_PROFILER_UDP
+    udp_sender_ = std::make_unique<AudioDebugger>();
+#endif
+    xTaskCreate([](void* arg) {
+        ((TaskProfiler*)arg)->ProfilerTask();
+        vTaskDelete(NULL);
+    }, "task_profiler", TASK_PROFILER_STACK_SIZE, this, 1, &task_handle_);
+    ESP_LOGI(TAG, "Sampling every %lu ms", period_ms_);
+}
+
+void TaskProfiler::ProfilerTask() {
+    TickType_t last_wake_time = xTaskGetTickCount();
+    while (true) {
+        TakeSample();
+#if CONFIG_TASK_PROFILER_UDP
+        if (sample_count_ > 0) {
+            auto json = GetProfileJson();
+            udp_sender_->Send(json.data(), json.size());
+        }
+#endif
+        vTaskDelayUntil(&last_wake_time, pdMS_TO_TICKS(period_ms_));
+    }
+}
+
+TaskProfiler::TaskProfile* TaskProfiler::FindProfile(TaskHandle_t handle) {
+    for (auto& profile : profiles_) {
+        if (profile.handle == handle) {
+            return &profile;
+        }
+    }
+    return nullptr;
+}
+
+void TaskProfiler::TakeSample() {
+    // The status array is reused between samples, it only grows when new tasks appear
+    size_t capacity = uxTaskGetNumberOfTasks() + TASK_STATUS_ARRAY_OFFSET;
+    if (status_.size() < capacity) {
+        status_.resize(capacity);
+    }
+    configRUN_TIME_COUNTER_TYPE total_run_time;
+    UBaseType_t count = uxTaskGetSystemState(status_.data(), status_.size(), &total_run_time);
+    if (count == 0) {
+        ESP_LOGW(TAG, "Task status array too small");
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    // The first snapshot only sets the baseline of the run time counters
+    bool has_baseline = last_total_run_time_ != 0;
+    configRUN_TIME_COUNTER_TYPE total_elapsed = total_run_time - last_total_run_time_;
+    last_total_run_time_ = total_run_time;
+    if (has_baseline && total_elapsed == 0) {
+        return;
+    }
+    uint32_t sample = has_baseline ? sample_count_ + 1 : 0;
+    size_t slot = sample % TASK_PROFILER_HISTORY;
+
+    for (UBaseType_t i = 0; i < count; i++) {
+        auto& status = status_[i];
+        auto profile = FindProfile(status.xHandle);
+        if (profile == nullptr) {
+            if (profiles_.size() >= TASK_PROFILER_MAX_TASKS) {
+                continue;
+            }
+            profiles_.emplace_back();
+            profile = &profiles_.back();
+            memset(profile, 0, sizeof(TaskProfile));
+            profile->handle = status.xHandle;
+            strncpy(profile->name, status.pcTaskName, sizeof(profile->name) - 1);
+            profile->stack_free_min = UINT32_MAX;
+            profile->last_run_time = status.ulRunTimeCounter;
+            // New tasks have no valid delta until the next sample
+            profile->first_sample = sample + 1;
+        } else if (has_baseline) {
+            uint64_t task_elapsed = status.ulRunTimeCounter - profile->last_run_time;
+            profile->cpu_permille[slot] = task_elapsed * 1000 / ((uint64_t)total_elapsed * CONFIG_FREERTOS_NUMBER_OF_CORES);
+            profile->last_run_time = status.ulRunTimeCounter;
+        }
+#if configTASKLIST_INCLUDE_COREID
+        profile->core = status.xCoreID == tskNO_AFFINITY ? -1 : status.xCoreID;
+#else
+        profile->core = -1;
+#endif
+        profile->priority = status.uxCurrentPriority;
+        profile->stack_free_min = std::min<uint32_t>(profile->stack_free_min, status.usStackHighWaterMark);
+        profile->last_sample = sample;
+    }
+
+    // Tasks missing from this snapshot have been deleted
+    profiles_.erase(std::remove_if(profiles_.begin(), profiles_.end(), [sample](const TaskProfile& profile) {
+        return profile.last_sample != sample;
+    }), profiles_.end());
+
+    if (!has_baseline) {
+        return;
+    }
+    // The idle task of each core accounts for the time that core had nothing to run
+    for (int core = 0; core < CONFIG_FREERTOS_NUMBER_OF_CORES; core++) {
+        auto idle = FindProfile(xTaskGetIdleTaskHandleForCore(core));
+        uint32_t idle_permille = 0;
+        if (idle != nullptr && idle->first_sample <= sample) {
+            idle_permille = std::min<uint32_t>(idle->cpu_permille[slot] * CONFIG_FREERTOS_NUMBER_OF_CORES, 1000);
+        }
+        core_load_permille_[core][slot] = 1000 - idle_permille;
+    }
+    sample_count_ = sample;
+}
+
+std::string TaskProfiler::GetProfileJson() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint32_t samples = std::min<uint32_t>(sample_count_, TASK_PROFILER_HISTORY);
+    uint32_t oldest_sample = sample_count_ - samples + 1;
+
+    std::string json;
+    JsonWriter writer(json, 128 + profiles_.size() * 96);
+    writer.BeginObject();
+    writer.Key("period_ms").Int(period_ms_);
+    writer.Key("samples").Int(samples);
+
+    writer.Key("cores").BeginArray();
+    for (int core = 0; core < CONFIG_FREERTOS_NUMBER_OF_CORES; core++) {
+        uint32_t sum = 0;
+        for (uint32_t s = oldest_sample; s <= sample_count_; s++) {
+            sum += core_load_permille_[core][s % TASK_PROFILER_HISTORY];
+        }
+        writer.Number(samples > 0 ? sum / 10.0 / samples : 0);
+    }
+    writer.EndArray();
+
+    // CPU usage is in percent of the total CPU time of all cores
+    writer.Key("tasks").BeginArray();
+    for (auto& profile : profiles_) {
+        uint32_t first = std::max(oldest_sample, profile.first_sample);
+        uint32_t sum = 0, peak = 0, count = 0;
+        for (uint32_t s = first; s <= sample_count_; s++) {
+            uint32_t value = profile.cpu_permille[s % TASK_PROFILER_HISTORY];
+            sum += value;
+            peak = std::max(peak, value);
+            count++;
+        }
+        writer.BeginObject();
+        writer.Key("name").String(profile.name);
+        writer.Key("core").Int(profile.core);
+        writer.Key("priority").Int(profile.priority);
+        writer.Key("cpu").Number(count > 0 ? sum / 10.0 / count : 0);
+        writer.Key("cpu_max").Number(peak / 10.0);
+        writer.Key("stack_free_min").Int(profile.stack_free_min);
+        writer.EndObject();
+    }
+    writer.EndArray();
+    writer.EndObject();
+    return json;
+}
@@ -0,0 +1,71 @@
+#ifndef TASK_PROFILER_H
+#define TASK_PROFILER_H
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+
+#define TASK_PROFILER_MAX_TASKS 40
+#define TASK_PROFILER_STACK_SIZE 3072
+#define TASK_PROFILER_HISTORY 12
+
+class AudioDebugger;
+
+/*
+ * Samples uxTaskGetSystemState periodically in a low priority task and keeps a short history
+ * of per task CPU usage and stack high water marks, so the main loop never waits for a
+ * sampling window like SystemInfo::PrintTaskCpuUsage does.
+ */
+class TaskProfiler {
+public:
+    static TaskProfiler& GetInstance() {
+        static TaskProfiler instance;
+        return instance;
+    }
+    // Delete copy constructor and assignment operator
+    TaskProfiler(const TaskProfiler&) = delete;
+    TaskProfiler& operator=(const TaskProfiler&) = delete;
+
+    void Start(uint32_t period_ms);
+    // Averages and peaks over the sample history, rendered as JSON
+    std::string GetProfileJson();
+
+private:
+    struct TaskProfile {
+        TaskHandle_t handle;
+        char name[configMAX_TASK_NAME_LEN];
+        int core;
+        UBaseType_t priority;
+        // CPU usage per sample in 0.1% of the total CPU time, indexed like the sample ring
+        uint16_t cpu_permille[TASK_PROFILER_HISTORY];
+        uint32_t stack_free_min;
+        configRUN_TIME_COUNTER_TYPE last_run_time;
+        uint32_t first_sample;
+        uint32_t last_sample;
+    };
+
+    TaskHandle_t task_handle_ = nullptr;
+    uint32_t period_ms_ = 0;
+    std::mutex mutex_;
+    std::vector<TaskStatus_t> status_;
+    std::vector<TaskProfile> profiles_;
+    uint16_t core_load_permille_[CONFIG_FREERTOS_NUMBER_OF_CORES][TASK_PROFILER_HISTORY] = {};
+    configRUN_TIME_COUNTER_TYPE last_total_run_time_ = 0;
+    uint32_t sample_count_ = 0;
+#if CONFIG_TASK_PROFILER_UDP
+    std::unique_ptr<AudioDebugger> udp_sender_;
+#endif
+
+    TaskProfiler();
+    ~TaskProfiler();
+
+    void ProfilerTask();
+    void TakeSample();
+    TaskProfile* FindProfile(TaskHandle_t handle);
+};
+
+#endif // TASK_PROFILER_H
@@ -0,0 +1,159 @@
+#include "trace_recorder.h"
+
+#if CONFIG_USE_TRACE_RECORDER
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <errno.h>
+#include <cstring>
+#include <cstddef>
+#include <string>
+#endif
+
+#define TAG "TraceRecorder"
+
+#define TRACE_PACKET_MAGIC 0x52545A58 // "XZTR"
+#define TRACE_PACKET_VERSION 1
+#define TRACE_PACKET_MAX_EVENTS 64
+#define TRACE_SEND_INTERVAL_MS 50
+
+#if CONFIG_USE_TRACE_RECORDER
+// Wire format, little endian, parsed by scripts/trace_to_chrome.py
+struct TraceRecord {
+    int64_t timestamp_us;
+    uint16_t event;
+    uint8_t phase;
+    uint8_t core;
+    int32_t arg;
+};
+static_assert(sizeof(TraceRecord) == 16, "TraceRecord must be 16 bytes");
+
+struct TracePacket {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t count;
+    uint32_t sequence;
+    uint32_t dropped;
+    TraceRecord records[TRACE_PACKET_MAX_EVENTS];
+};
+
+static TraceRecord* trace_ring_ = nullptr;
+static uint32_t trace_head_ = 0;
+static uint32_t trace_tail_ = 0;
+static uint32_t trace_dropped_ = 0;
+static portMUX_TYPE trace_spinlock_ = portMUX_INITIALIZER_UNLOCKED;
+#endif
+
+
+void TraceRecorder::Start() {
+#if CONFIG_USE_TRACE_RECORDER
+    if (trace_ring_ != nullptr) {
+        return;
+    }
+    trace_ring_ = (TraceRecord*)heap_caps_malloc(sizeof(TraceRecord) * CONFIG_TRACE_BUFFER_EVENTS, MALLOC_CAP_SPIRAM);
+    if (trace_ring_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate trace buffer");
+        return;
+    }
+    xTaskCreate(SenderTask, "trace_sender", 4096, nullptr, 1, nullptr);
+    ESP_LOGI(TAG, "Recording %d events, streaming to %s", CONFIG_TRACE_BUFFER_EVENTS, CONFIG_TRACE_UDP_SERVER);
+#endif
+}
+
+void TraceRecorder::Record(TraceEventId event, TracePhase phase, int32_t arg) {
+#if CONFIG_USE_TRACE_RECORDER
+    if (trace_ring_ == nullptr) {
+        return;
+    }
+    int64_t now = esp_timer_get_time();
+    // May be called from LVGL callbacks and ISRs as well as from tasks
+    portENTER_CRITICAL_SAFE(&trace_spinlock_);
+    auto& record = trace_ring_[trace_head_ % CONFIG_TRACE_BUFFER_EVENTS];
+    record.timestamp_us = now;
+    record.event = event;
+    record.phase = phase;
+    record.core = xPortGetCoreID();
+    record.arg = arg;
+    trace_head_++;
+    portEXIT_CRITICAL_SAFE(&trace_spinlock_);
+#endif
+}
+
+void TraceRecorder::SenderTask(void* arg) {
+#if CONFIG_USE_TRACE_RECORDER
+    std::string server_addr = CONFIG_TRACE_UDP_SERVER;
+    size_t colon_pos = server_addr.find(':');
+    if (colon_pos == std::string::npos) {
+        ESP_LOGW(TAG, "Invalid server address: %s, should be IP:PORT", CONFIG_TRACE_UDP_SERVER);
+        vTaskDelete(NULL);
+        return;
+    }
+    struct sockaddr_in server = {};
+    server.sin_family = AF_INET;
+    server.sin_port = htons(std::stoi(server_addr.substr(colon_pos + 1)));
+    inet_pton(AF_INET, server_addr.substr(0, colon_pos).c_str(), &server.sin_addr);
+
+    TracePacket* packet = nullptr;
+    int sockfd = -1;
+
+    while (true) {
+        vTaskDelay(pdMS_TO_TICKS(TRACE_SEND_INTERVAL_MS));
+        if (packet == nullptr) {
+            packet = (TracePacket*)heap_caps_malloc(sizeof(TracePacket), MALLOC_CAP_8BIT);
+            if (packet == nullptr) {
+                // Nothing can be sent without the packet buffer, drop the pending events and try again later
+                ESP_LOGW(TAG, "Failed to allocate trace packet");
+                portENTER_CRITICAL(&trace_spinlock_);
+                trace_dropped_ += trace_head_ - trace_tail_;
+                trace_tail_ = trace_head_;
+                portEXIT_CRITICAL(&trace_spinlock_);
+                continue;
+            }
+            packet->magic = TRACE_PACKET_MAGIC;
+            packet->version = TRACE_PACKET_VERSION;
+            packet->sequence = 0;
+        }
+        // The socket can only be created once the network stack is up
+        if (sockfd < 0) {
+            sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+            if (sockfd < 0) {
+                continue;
+            }
+        }
+
+        while (true) {
+            portENTER_CRITICAL(&trace_spinlock_);
+            if (trace_head_ - trace_tail_ > CONFIG_TRACE_BUFFER_EVENTS) {
+                // The sender fell behind, the oldest events have been overwritten
+                trace_dropped_ += trace_head_ - trace_tail_ - CONFIG_TRACE_BUFFER_EVENTS;
+                trace_tail_ = trace_head_ - CONFIG_TRACE_BUFFER_EVENTS;
+            }
+            uint32_t count = trace_head_ - trace_tail_;
+            if (count > TRACE_PACKET_MAX_EVENTS) {
+                count = TRACE_PACKET_MAX_EVENTS;
+            }
+            for (uint32_t i = 0; i < count; i++) {
+                packet->records[i] = trace_ring_[(trace_tail_ + i) % CONFIG_TRACE_BUFFER_EVENTS];
+            }
+            trace_tail_ += count;
+            packet->dropped = trace_dropped_;
+            portEXIT_CRITICAL(&trace_spinlock_);
+
+            if (count == 0) {
+                break;
+            }
+            packet->count = count;
+            size_t size = offsetof(TracePacket, records) + count * sizeof(TraceRecord);
+            if (sendto(sockfd, packet, size, 0, (struct sockaddr*)&server, sizeof(server)) < 0) {
+                ESP_LOGD(TAG, "Failed to send trace packet: %d", errno);
+            }
+            packet->sequence++;
+        }
+    }
+#endif
+}
@@ -0,0 +1,70 @@
+#ifndef TRACE_RECORDER_H
+#define TRACE_RECORDER_H
+
+#include <cstdint>
+#include "sdkconfig.h"
+
+// Keep in sync with EVENTS in scripts/trace_to_chrome.py
+enum TraceEventId : uint16_t {
+    kTraceEventDeviceState,
+    kTraceEventWakeWord,
+    kTraceEventAudioInput,
+    kTraceEventAudioOutput,
+    kTraceEventOpusEncode,
+    kTraceEventOpusDecode,
+    kTraceEventAudioChannelOpen,
+    kTraceEventAudioChannelClose,
+    kTraceEventMcpToolCall,
+    kTraceEventLvglRender,
+    kTraceEventLvglFlush,
+    kTraceEventMainTask,
+};
+
+enum TracePhase : uint8_t {
+    kTracePhaseBegin = 'B',
+    kTracePhaseEnd = 'E',
+    kTracePhaseInstant = 'i',
+};
+
+/*
+ * Records begin / end / instant events into a ring buffer in PSRAM and streams them
+ * in batches over UDP to CONFIG_TRACE_UDP_SERVER, where scripts/trace_to_chrome.py
+ * turns them into a Chrome trace. Use the TRACE_* macros, they compile to nothing
+ * when CONFIG_USE_TRACE_RECORDER is disabled.
+ */
+class TraceRecorder {
+public:
+    static void Start();
+    static void Record(TraceEventId event, TracePhase phase, int32_t arg = 0);
+
+private:
+    static void SenderTask(void* arg);
+};
+
+class TraceScope {
+public:
+    TraceScope(TraceEventId event, int32_t arg = 0) : event_(event), arg_(arg) {
+        TraceRecorder::Record(event_, kTracePhaseBegin, arg_);
+    }
+    ~TraceScope() {
+        TraceRecorder::Record(event_, kTracePhaseEnd, arg_);
+    }
+
+private:
+    TraceEventId event_;
+    int32_t arg_;
+};
+
+#if CONFIG_USE_TRACE_RECORDER
+#define TRACE_BEGIN(event, ...) TraceRecorder::Record(event, kTracePhaseBegin, ##__VA_ARGS__)
+#define TRACE_END(event, ...) TraceRecorder::Record(event, kTracePhaseEnd, ##__VA_ARGS__)
+#define TRACE_INSTANT(event, ...) TraceRecorder::Record(event, kTracePhaseInstant, ##__VA_ARGS__)
+#define TRACE_SCOPE(event, ...) TraceScope trace_scope(event, ##__VA_ARGS__)
+#else
+#define TRACE_BEGIN(event, ...) do {} while (0)
+#define TRACE_END(event, ...) do {} while (0)
+#define TRACE_INSTANT(event, ...) do {} while (0)
+#define TRACE_SCOPE(event, ...) do {} while (0)
+#endif
+
+#endif // TRACE_RECORDER_H
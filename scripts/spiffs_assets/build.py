@@ -5,7 +5,8 @@ Build the spiffs assets partition
 Usage:
     ./build.py --wakenet_model <wakenet_model_dir> \
         --text_font <text_font_file> \
-        --emoji_collection <emoji_collection_dir>
+        --emoji_collection <emoji_collection_dir> \
+        [--convert_gif]
 
 Example:
     ./build.py --wakenet_model ../../managed_components/espressif__esp-sr/model/wakenet_model/wn9_nihaoxiaozhi_tts \
@@ -21,6 +22,8 @@ import subprocess
 import json
 from pathlib import Path
 
+from gif_to_rla import convert_file
+
 
 def ensure_dir(directory):
     """Ensure directory exists, create if not"""
@@ -86,7 +89,7 @@ def process_text_font(text_font_file, assets_dir):
     return font_filename
 
 
-def process_emoji_collection(emoji_collection_dir, assets_dir):
+def process_emoji_collection(emoji_collection_dir, assets_dir, convert_gif=False):
     """Process emoji_collection parameter"""
     if not emoji_collection_dir:
         return []
@@ -97,10 +100,15 @@ def process_emoji_collection(emoji_collection_dir, assets_dir):
     for root, dirs, files in os.walk(emoji_collection_dir):
         for file in files:
             if file.lower().endswith(('.png', '.gif')):
-                # Copy file
                 src_file = os.path.join(root, file)
-                dst_file = os.path.join(assets_dir, file)
-                copy_file(src_file, dst_file)
+                if convert_gif and file.lower().endswith('.gif'):
+                    # Pre-decode the GIF, so the device plays it without LZW decoding
+                    file = os.path.splitext(file)[0] + '.rla'
+                    convert_file(src_file, os.path.join(assets_dir, file))
+                else:
+                    # Copy file
+                    dst_file = os.path.join(assets_dir, file)
+                    copy_file(src_file, dst_file)
                 
                 # Get filename without extension
                 filename_without_ext = os.path.splitext(file)[0]
@@ -316,7 +324,7 @@ def generate_config_json(build_dir, assets_dir):
         "image_file": os.path.join(workspace_dir, "build/output/assets.bin"),
         "lvgl_ver": "9.3.0",
         "assets_size": "0x400000",
-        "support_format": ".png, .gif, .jpg, .bin, .json, .eaf",
+        "support_format": ".png, .gif, .rla, .jpg, .bin, .json, .eaf",
         "name_length": "32",
         "split_height": "0",
         "support_qoi": False,
@@ -342,6 +350,7 @@ def main():
     parser.add_argument('--wakenet_model', help='Path to wakenet model directory')
     parser.add_argument('--text_font', help='Path to text font file')
     parser.add_argument('--emoji_collection', help='Path to emoji collection directory')
+    parser.add_argument('--convert_gif', action='store_true', help='Convert GIF emojis to the pre-decoded RLE animation format')
 
     parser.add_argument('--res_path', help='Path to res directory')
     parser.add_argument('--target_board', help='Path to target board directory')
@@ -370,7 +379,7 @@ def main():
     if(args.target_board):
         emoji_collection, icon_collection, layout_json = process_board_collection(args.target_board, args.res_path, assets_dir)
     else:
-        emoji_collection = process_emoji_collection(args.emoji_collection, assets_dir)
+        emoji_collection = process_emoji_collection(args.emoji_collection, assets_dir, args.convert_gif)
         icon_collection = []
         layout_json = []
     
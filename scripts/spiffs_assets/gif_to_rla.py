@@ -0,0 +1,185 @@
+#!/usr/bin/env python3
+"""
+Convert GIF animations to the pre-decoded RLE animation format (.rla) played by
+LvglRleAnimation (main/display/lvgl_display/anim/lvgl_rle_animation.h)
+
+Every frame is composited at build time and stored as RGB565 (plus A8 if the GIF
+has transparency) run length ops over the rect that changed since the previous
+frame, so the device copies pixels straight from flash into one canvas instead
+of running LZW and keeping an ARGB8888 canvas and an index buffer.
+
+Usage:
+    ./gif_to_rla.py <gif file or directory> [...] [--output <dir>]
+"""
+
+import os
+import sys
+import struct
+import argparse
+
+import numpy as np
+from PIL import Image, ImageSequence
+
+
+MAGIC = b'RLEA'
+VERSION = 1
+FLAG_ALPHA = 0x01
+HEADER = struct.Struct('<4sBBHHHHH')
+FRAME_ENTRY = struct.Struct('<IIHHHHHH')
+
+OP_SKIP = 0
+OP_FILL = 1
+OP_COPY = 2
+MAX_COUNT = 64
+
+
+def load_frames(gif_path):
+    """Return the composited RGBA frames, their delays in ms and the loop count"""
+    with Image.open(gif_path) as im:
+        # GIF loop N repeats N times, no NETSCAPE block plays once, 0 plays forever
+        loop = im.info.get('loop')
+        loop_count = 1 if loop is None else (0 if loop == 0 else loop + 1)
+        frames = []
+        delays = []
+        for frame in ImageSequence.Iterator(im):
+            frames.append(np.array(frame.convert('RGBA')))
+            delays.append(frame.info.get('duration', 0))
+    return frames, delays, loop_count
+
+
+def to_pixels(rgba, has_alpha):
+    """Pack RGBA to RGB565 << 8 | A8, with fully transparent pixels normalized to 0"""
+    r = rgba[..., 0].astype(np.uint32)
+    g = rgba[..., 1].astype(np.uint32)
+    b = rgba[..., 2].astype(np.uint32)
+    a = rgba[..., 3].astype(np.uint32) if has_alpha else np.full(r.shape, 0xFF, np.uint32)
+    rgb565 = ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3)
+    pixels = (rgb565 << 8) | a
+    if has_alpha:
+        pixels[a == 0] = 0
+    return pixels
+
+
+def pack_pixel(pixel, has_alpha):
+    data = struct.pack('<H', pixel >> 8)
+    if has_alpha:
+        data += bytes([pixel & 0xFF])
+    return data
+
+
+def encode_ops(pixels, skippable, has_alpha):
+    """Encode the flattened rect pixels, skipping the pixels that did not change"""
+    out = bytearray()
+    n = len(pixels)
+    i = 0
+    while i < n:
+        j = i
+        if skippable[i]:
+            while j < n and j - i < MAX_COUNT and skippable[j]:
+                j += 1
+            out.append((OP_SKIP << 6) | (j - i - 1))
+            i = j
+            continue
+
+        while j < n and j - i < MAX_COUNT and pixels[j] == pixels[i]:
+            j += 1
+        if j - i >= 2:
+            out.append((OP_FILL << 6) | (j - i - 1))
+            out += pack_pixel(int(pixels[i]), has_alpha)
+            i = j
+            continue
+
+        # Literal pixels until a skip or a run starts
+        j = i + 1
+        while j < n and j - i < MAX_COUNT and not skippable[j] and not (j + 1 < n and pixels[j + 1] == pixels[j]):
+            j += 1
+        out.append((OP_COPY << 6) | (j - i - 1))
+        for k in range(i, j):
+            out += pack_pixel(int(pixels[k]), has_alpha)
+        i = j
+    return bytes(out)
+
+
+def convert_gif(gif_path):
+    """Return the .rla data of a GIF file"""
+    frames, delays, loop_count = load_frames(gif_path)
+    height, width = frames[0].shape[:2]
+    has_alpha = any((frame[..., 3] < 0xFF).any() for frame in frames)
+
+    entries = []
+    chunks = []
+    previous = None
+    for frame, delay in zip(frames, delays):
+        pixels = to_pixels(frame, has_alpha)
+        if previous is None:
+            # The first frame covers the whole canvas, so looping back needs no reset
+            x, y, w, h = 0, 0, width, height
+            changed = np.ones(pixels.shape, bool)
+        else:
+            changed = pixels != previous
+            rows = np.flatnonzero(changed.any(axis=1))
+            cols = np.flatnonzero(changed.any(axis=0))
+            if len(rows) == 0:
+                x, y, w, h = 0, 0, 0, 0
+            else:
+                x, y = int(cols[0]), int(rows[0])
+                w, h = int(cols[-1]) - x + 1, int(rows[-1]) - y + 1
+        rect = pixels[y:y + h, x:x + w].ravel()
+        skippable = ~changed[y:y + h, x:x + w].ravel()
+        chunks.append(encode_ops(rect, skippable, has_alpha))
+        entries.append((min(delay, 0xFFFF), x, y, w, h))
+        previous = pixels
+
+    offset = HEADER.size + FRAME_ENTRY.size * len(frames)
+    data = bytearray(HEADER.pack(MAGIC, VERSION, FLAG_ALPHA if has_alpha else 0,
+                                 width, height, len(frames), loop_count, 0))
+    for (delay, x, y, w, h), chunk in zip(entries, chunks):
+        data += FRAME_ENTRY.pack(offset, len(chunk), delay, x, y, w, h, 0)
+        offset += len(chunk)
+    for chunk in chunks:
+        data += chunk
+    return bytes(data), width, height, len(frames), has_alpha
+
+
+def convert_file(gif_path, rla_path):
+    """Write the .rla file and print how it compares to playing the GIF with gifdec"""
+    data, width, height, frame_count, has_alpha = convert_gif(gif_path)
+    with open(rla_path, 'wb') as f:
+        f.write(data)
+    gif_size = os.path.getsize(gif_path)
+    # gifdec keeps an ARGB8888 canvas plus an index buffer, the RLE player one RGB565(A8) canvas
+    gif_ram = width * height * 5
+    rla_ram = width * height * (3 if has_alpha else 2)
+    print(f"{os.path.basename(gif_path)}: {width}x{height}, {frame_count} frames, "
+          f"flash {gif_size} -> {len(data)} bytes, canvas RAM {gif_ram} -> {rla_ram} bytes")
+    return gif_size, len(data)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Convert GIF animations to the RLE animation format')
+    parser.add_argument('inputs', nargs='+', help='GIF files or directories')
+    parser.add_argument('--output', '-o', help='Output directory (default: next to the GIF)')
+    args = parser.parse_args()
+
+    gif_files = []
+    for path in args.inputs:
+        if os.path.isdir(path):
+            for root, dirs, files in os.walk(path):
+                gif_files += [os.path.join(root, f) for f in sorted(files) if f.lower().endswith('.gif')]
+        else:
+            gif_files.append(path)
+
+    total_gif = total_rla = 0
+    for gif_path in gif_files:
+        output_dir = args.output or os.path.dirname(gif_path)
+        os.makedirs(output_dir, exist_ok=True)
+        rla_path = os.path.join(output_dir, os.path.splitext(os.path.basename(gif_path))[0] + '.rla')
+        gif_size, rla_size = convert_file(gif_path, rla_path)
+        total_gif += gif_size
+        total_rla += rla_size
+    if len(gif_files) > 1:
+        print(f"Total flash {total_gif} -> {total_rla} bytes")
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,162 @@
+import socket
+import struct
+import json
+import argparse
+
+
+'''
+  Receive the trace events streamed by the device (CONFIG_USE_TRACE_RECORDER) over UDP
+  and convert them to a Chrome trace JSON file, which can be opened in https://ui.perfetto.dev
+  or chrome://tracing. Press Ctrl+C to stop receiving and write the file.
+  The raw packets can be saved with --save and converted again later with --replay.
+'''
+
+PACKET_MAGIC = 0x52545A58
+PACKET_HEADER = struct.Struct('<IHHII')
+RECORD = struct.Struct('<qHBBi')
+
+# Same order as TraceEventId in main/trace_recorder.h, each event gets its own track
+EVENTS = [
+    ('device_state', 'state'),
+    ('wake_word', 'audio_input'),
+    ('audio_input', 'audio_input'),
+    ('audio_output', 'audio_output'),
+    ('opus_encode', 'opus_encode'),
+    ('opus_decode', 'opus_decode'),
+    ('audio_channel_open', 'protocol'),
+    ('audio_channel_close', 'protocol'),
+    ('mcp_tool_call', 'mcp'),
+    ('lvgl_render', 'display'),
+    ('lvgl_flush', 'display'),
+    ('main_task', 'main_loop'),
+]
+
+# Same order as DeviceState in main/device_state.h
+DEVICE_STATES = [
+    'unknown', 'starting', 'configuring', 'idle', 'connecting', 'listening',
+    'speaking', 'upgrading', 'activating', 'audio_testing', 'fatal_error',
+]
+
+TRACKS = []
+for _, track in EVENTS:
+    if track not in TRACKS:
+        TRACKS.append(track)
+
+
+def event_name(event, arg):
+    if event >= len(EVENTS):
+        return f'event_{event}'
+    name = EVENTS[event][0]
+    if name == 'device_state' and 0 <= arg < len(DEVICE_STATES):
+        return DEVICE_STATES[arg]
+    return name
+
+
+class TraceConverter:
+    def __init__(self):
+        self.events = []
+        self.open_spans = {}
+        self.last_sequence = None
+        self.lost_packets = 0
+        self.dropped = 0
+
+    def add_packet(self, data):
+        if len(data) < PACKET_HEADER.size:
+            return
+        magic, version, count, sequence, dropped = PACKET_HEADER.unpack_from(data)
+        if magic != PACKET_MAGIC or version != 1:
+            print(f'Ignored packet with magic {magic:08x} version {version}')
+            return
+        if self.last_sequence is not None and sequence != self.last_sequence + 1:
+            self.lost_packets += max(sequence - self.last_sequence - 1, 0)
+        self.last_sequence = sequence
+        self.dropped = dropped
+
+        for i in range(count):
+            timestamp, event, phase, core, arg = RECORD.unpack_from(data, PACKET_HEADER.size + i * RECORD.size)
+            self.add_record(timestamp, event, chr(phase), core, arg)
+
+    def add_record(self, timestamp, event, phase, core, arg):
+        track = EVENTS[event][1] if event < len(EVENTS) else 'unknown'
+        if track not in TRACKS:
+            TRACKS.append(track)
+        key = (event, track)
+        # Drop ends without a begin, e.g. the state before the recorder started
+        if phase == 'B':
+            self.open_spans[key] = self.open_spans.get(key, 0) + 1
+        elif phase == 'E':
+            if self.open_spans.get(key, 0) == 0:
+                return
+            self.open_spans[key] -= 1
+
+        trace_event = {
+            'name': event_name(event, arg),
+            'ph': phase,
+            'ts': timestamp,
+            'pid': 1,
+            'tid': TRACKS.index(track) + 1,
+            'args': {'arg': arg, 'core': core},
+        }
+        if phase == 'i':
+            trace_event['s'] = 't'
+        self.events.append(trace_event)
+
+    def write(self, filename):
+        metadata = [{'name': 'process_name', 'ph': 'M', 'pid': 1, 'args': {'name': 'xiaozhi'}}]
+        for i, track in enumerate(TRACKS):
+            metadata.append({'name': 'thread_name', 'ph': 'M', 'pid': 1, 'tid': i + 1, 'args': {'name': track}})
+        with open(filename, 'w') as f:
+            json.dump({'traceEvents': metadata + self.events, 'displayTimeUnit': 'ms'}, f)
+        print(f'Wrote {len(self.events)} events to {filename}, '
+              f'{self.lost_packets} packets lost, {self.dropped} events dropped on the device')
+
+
+def receive(port, converter, save_file):
+    server_socket = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    server_socket.bind(('0.0.0.0', port))
+    print(f'Receiving trace events on 0.0.0.0:{port}, press Ctrl+C to stop...')
+    try:
+        while True:
+            message, address = server_socket.recvfrom(2048)
+            if save_file:
+                save_file.write(struct.pack('<H', len(message)) + message)
+            converter.add_packet(message)
+    except KeyboardInterrupt:
+        print('\nStopping...')
+    finally:
+        server_socket.close()
+
+
+def replay(filename, converter):
+    with open(filename, 'rb') as f:
+        while True:
+            header = f.read(2)
+            if len(header) < 2:
+                break
+            (length,) = struct.unpack('<H', header)
+            converter.add_packet(f.read(length))
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Convert device trace events to Chrome trace JSON')
+    parser.add_argument('--port', '-p', type=int, default=8001, help='UDP port to listen on (default: 8001)')
+    parser.add_argument('--output', '-o', default='trace.json', help='Chrome trace JSON file (default: trace.json)')
+    parser.add_argument('--save', '-s', help='Also save the raw packets to this file')
+    parser.add_argument('--replay', '-r', help='Convert raw packets saved with --save instead of listening')
+    args = parser.parse_args()
+
+    converter = TraceConverter()
+    if args.replay:
+        replay(args.replay, converter)
+    else:
+        save_file = open(args.save, 'wb') if args.save else None
+        try:
+            receive(args.port, converter, save_file)
+        finally:
+            if save_file:
+                save_file.close()
+    converter.write(args.output)
+
+
+if __name__ == '__main__':
+    main()